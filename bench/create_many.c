@@ -0,0 +1,79 @@
+/**
+ * @file create_many.c
+ * @brief Benchmark of the thread creation cost, one `dccthread_create` per
+ * thread against a single `dccthread_create_many`.
+ *
+ * Usage: ./bench/create_many [single|many|both] [threads]
+ *
+ * The threads are only created, not run; the process exits right after. Both
+ * modes are measured by default, each in its own process so that neither
+ * inherits the heap of the other.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "dccthread.h"
+
+int n_threads = 10000;
+int many = 0;
+
+void worker(int dummy) { dccthread_exit(); }
+
+void bench(int dummy) {
+    struct timespec start, end;
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(many) {
+        if(dccthread_create_many(n_threads, worker, NULL, NULL, NULL)) {
+            printf("Error while creating the threads\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    else {
+        for(int i = 0; i < n_threads; i++) {
+            if(!dccthread_create("worker", worker, i)) {
+                printf("Error while creating thread %d\n", i);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_SELF, &after);
+
+    double secs =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%s: %d threads in %.3fms, %.0fns per thread, %ld minor faults\n",
+           many ? "many" : "single",
+           n_threads,
+           secs * 1e3,
+           secs * 1e9 / n_threads,
+           after.ru_minflt - before.ru_minflt);
+    exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char** argv) {
+    if(argc > 2) n_threads = atoi(argv[2]);
+    if(argc > 1 && !strcmp(argv[1], "single")) dccthread_init(bench, 0);
+    if(argc > 1 && !strcmp(argv[1], "many")) {
+        many = 1;
+        dccthread_init(bench, 0);
+    }
+
+    for(many = 0; many < 2; many++) {
+        pid_t pid = fork();
+        if(pid == -1) {
+            printf("Error while forking\n");
+            exit(EXIT_FAILURE);
+        }
+        if(!pid) dccthread_init(bench, 0);
+        waitpid(pid, NULL, 0);
+    }
+    return 0;
+}
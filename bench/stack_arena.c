@@ -0,0 +1,72 @@
+/**
+ * @file stack_arena.c
+ * @brief Benchmark of the context switch throughput with many threads, with
+ * and without DCCTHREAD_STACK_ARENA.
+ *
+ * Usage: ./bench/stack_arena [malloc|arena] [threads] [rounds]
+ *
+ * Every thread yields in a loop, touching its stack each time. The switches
+ * are timed until each thread got <rounds> turns on average; the process exits
+ * right after, without tearing the threads down.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "dccthread.h"
+
+int n_threads = 100000;
+int n_rounds = 10;
+volatile long n_switches = 0;
+
+void worker(int dummy) {
+    // Touch some stack on every switch, as real threads do
+    volatile char frame[512];
+    for(long i = 0;; i++) {
+        frame[i % sizeof(frame)] = i;
+        n_switches++;
+        dccthread_yield();
+    }
+}
+
+void bench(int flags) {
+    struct timespec start, end;
+    for(int i = 0; i < n_threads; i++) {
+        if(!dccthread_create("worker", worker, 0)) {
+            printf("Error while creating thread %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    n_switches = 0;
+    while(n_switches < (long)n_threads * n_rounds) dccthread_yield();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double secs =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%s: %d threads, %ld switches in %.3fs, %.0f switches/s, "
+           "%ld minor faults, %ld MiB max RSS\n",
+           flags & DCCTHREAD_STACK_ARENA ? "arena" : "malloc",
+           n_threads,
+           n_switches,
+           secs,
+           n_switches / secs,
+           usage.ru_minflt,
+           usage.ru_maxrss / 1024);
+    exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char** argv) {
+    int flags = 0;
+    if(argc > 1 && !strcmp(argv[1], "arena")) flags |= DCCTHREAD_STACK_ARENA;
+    if(argc > 2) n_threads = atoi(argv[2]);
+    if(argc > 3) n_rounds = atoi(argv[3]);
+
+    dccthread_init_flags(bench, flags, flags);
+}
@@ -11,16 +11,156 @@
  *
  */
 
+#define _GNU_SOURCE
 #include "dccthread.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #define PRE_EMPTION_SIG SIGUSR1
-#define SLEEP_SIGNAL SIGUSR2
+#define PRECISE_SIGNAL SIGRTMIN
+#define PROFILE_SIGNAL SIGPROF
+#define RESUME_SIGNAL (SIGRTMIN + 1)
+
+// Stack the scheduler signals are handled on, on top of what the kernel needs
+// for the signal frame
+#define SIGNAL_STACK_SIZE (64 << 10)
+// On x86_64 a pre-empted thread is switched out from the signal handler and
+// resumed by a signal return, so no handler ever runs on the thread stacks
+#if defined(__x86_64__)
+#define PREEMPT_FROM_HANDLER 1
+// Software reserved bytes of the legacy floating point area, describing the
+// extended state that follows it
+#define XSTATE_SW_OFFSET 464
+#define XSTATE_MAGIC 0x46505853u
+#define FPSTATE_CHUNK_SIZE (64 << 10)
+#define SWITCH_SIGNAL_FLAGS SA_ONSTACK
+#else
+// Elsewhere the handlers that switch threads run on the thread stack, which
+// keeps their signal frame while the thread is switched out
+#define SWITCH_SIGNAL_FLAGS 0
+#endif
+
+// Profiler sample buffer limits
+#define PROFILE_SAMPLES (1 << 14)
+// Stack arena layout: each stack has a gap below it, whose top holds a canary
+#define ARENA_REGION_SIZE (2 << 20)
+#define ARENA_GAP_SIZE 4096
+#define ARENA_SLOT_SIZE (ARENA_GAP_SIZE + THREAD_STACK_SIZE)
+#define ARENA_CANARY 0xdcc0ca9a7dcc0ca9ull
+#define ARENA_CANARY_WORDS 8
+
+// Chunks of the `dccthread_alloc` regions, and how many each scheduler keeps
+#define REGION_CHUNK_SIZE (64 << 10)
+#define REGION_CACHE_MAX 256
+#define REGION_ALIGN 16
+// Requests larger than this get a chunk of their own
+#define REGION_LARGE (REGION_CHUNK_SIZE / 4)
+
+// Wait queues of `dccthread_park_on`, must be a power of two
+#define PARK_BUCKETS 256
+#define PROFILE_DEPTH 16
+#define PROFILE_NAME_SIZE 48
+
+// Older glibc versions don't name the SIGEV_THREAD_ID target field
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
 
 /**
  * @brief An enumeration of all avaiable thread states.
  *
  */
-enum u_int8_t { RUNNING, RUNNABLE, WAITING, SLEEPING } THREAD_STATE;
+enum u_int8_t {
+    RUNNING,
+    RUNNABLE,
+    WAITING,
+    SLEEPING,
+    PARKED,
+    PARKED_ON,
+    OFFLOADED,
+    THROTTLED
+} THREAD_STATE;
+
+static const char* const state_names[] = {"RUNNING",
+                                          "RUNNABLE",
+                                          "WAITING",
+                                          "SLEEPING",
+                                          "PARKED",
+                                          "PARKED_ON",
+                                          "OFFLOADED",
+                                          "THROTTLED"};
+
+/**
+ * @brief A scheduling group, charged for the time its threads run.
+ *
+ */
+struct dccthread_group {
+    unsigned int weight;
+    /**
+     * @brief Run time in nanoseconds, scaled by DCCTHREAD_DEFAULT_WEIGHT /
+     * weight. The runnable group with the lowest one runs next.
+     *
+     */
+    u_int64_t vruntime;
+};
+
+/**
+ * @brief Earliest deadline first parameters and state of a thread.
+ *
+ */
+struct edf {
+    int active;
+    struct timespec relative_deadline;
+    struct timespec period;
+    struct timespec budget;
+    /**
+     * @brief Release time and absolute deadline of the current job.
+     *
+     */
+    struct timespec release;
+    struct timespec deadline;
+    /**
+     * @brief Time the current job has run, in nanoseconds.
+     *
+     */
+    u_int64_t used;
+    /**
+     * @brief Whether the current job used up its budget, or was already counted
+     * as a miss.
+     *
+     */
+    int throttled;
+    int missed;
+    u_int64_t misses;
+};
+
+/**
+ * @brief Descriptors and stacks allocated together by `dccthread_create_many`,
+ * freed when the last of its threads is.
+ *
+ */
+struct thread_batch {
+    dccthread_t* threads;
+    /**
+     * @brief One block for all the stacks, NULL if they came from the arena.
+     *
+     */
+    char* stacks;
+    int n_threads;
+    /**
+     * @brief How many threads of the batch weren't freed yet.
+     *
+     */
+    int live;
+};
 
 /**
  * @brief A struct that defines a DCC thread.
@@ -31,8 +171,339 @@ struct dccthread {
     enum u_int8_t state;
     ucontext_t t_context;
     dccthread_t* t_waiting;
+    /**
+     * @brief The thread stack.
+     *
+     */
+    char* t_stack;
+    /**
+     * @brief The thread function and its parameter.
+     *
+     */
+    void (*t_func)(int);
+    int t_param;
+    /**
+     * @brief The scheduling group of the thread.
+     *
+     */
+    dccthread_group_t* t_group;
+    /**
+     * @brief The scheduler that owns the thread, for the requests made from
+     * other OS threads.
+     *
+     */
+    scheduler_t* t_sched;
+    /**
+     * @brief How many times the thread disabled its own pre-emption.
+     *
+     */
+    int t_preempt_depth;
+    /**
+     * @brief Its node on the scheduler list, so that joining and leaving the
+     * list allocates nothing.
+     *
+     */
+    struct dnode t_node;
+    /**
+     * @brief Whether its entry point was set up, which `dispatch` leaves for
+     * the first time it runs so that creating it doesn't touch its stack.
+     *
+     */
+    int t_started;
+    /**
+     * @brief Floating point state of a thread pre-empted from the signal
+     * handler, whose registers are in <t_context>. NULL if the thread left the
+     * CPU through `swapcontext`.
+     *
+     */
+    void* t_fpstate;
+    /**
+     * @brief The `dccthread_create_many` batch holding the descriptor and the
+     * stack, NULL if they were allocated on their own.
+     *
+     */
+    struct thread_batch* t_batch;
+    /**
+     * @brief The earliest deadline first state of the thread.
+     *
+     */
+    struct edf t_edf;
+    /**
+     * @brief Wake up time of a sleeping thread, on the virtual clock or, for
+     * precise sleeps, on CLOCK_MONOTONIC.
+     *
+     */
+    struct timespec t_deadline;
+    /**
+     * @brief Whether the thread is in a precise sleep.
+     *
+     */
+    int t_precise;
+    /**
+     * @brief Whether the thread was just woken from a precise sleep and has
+     * not been dispatched since, so it goes before the fair share pick.
+     *
+     */
+    int t_precise_woken;
+    //-------------- Timeout infos ---------------------------------------------
+    /**
+     * @brief When the scheduler wakes the thread up if nothing else does.
+     *
+     */
+    struct timespec t_timer_at;
+    /**
+     * @brief Position of the thread in the timer heap, -1 if not in it.
+     *
+     */
+    int t_timer_index;
+    /**
+     * @brief Whether the last blocking call ended because of its timeout.
+     *
+     */
+    int t_timed_out;
+    /**
+     * @brief The thread this one is waiting for, if any.
+     *
+     */
+    dccthread_t* t_wait_target;
+    //-------------- Inbox infos -----------------------------------------------
+    /**
+     * @brief Next thread in the scheduler inbox.
+     *
+     */
+    dccthread_t* t_inbox_next;
+    /**
+     * @brief Whether the thread is already in the inbox, so that repeated
+     * remote wake ups coalesce.
+     *
+     */
+    atomic_int t_inbox_queued;
+    /**
+     * @brief Whether the thread was created by `dccthread_create_remote` and
+     * still has to be added to the threads list.
+     *
+     */
+    int t_remote_spawn;
+    /**
+     * @brief A wake up delivered while the thread was not parked.
+     *
+     */
+    int t_wake_pending;
+    /**
+     * @brief Address the thread is parked on and the next thread of its wait
+     * queue.
+     *
+     */
+    volatile int* t_park_addr;
+    dccthread_t* t_park_next;
+    /**
+     * @brief The generator the thread is running, if any.
+     *
+     */
+    dccthread_gen_t* t_gen;
+    /**
+     * @brief When the thread last left the CPU, so since when it is blocked or
+     * waiting to run again.
+     *
+     */
+    struct timespec t_state_since;
+    /**
+     * @brief Whether its stack was reclaimed since it blocked.
+     *
+     */
+    int t_reclaimed;
+    //-------------- Thread specific values ------------------------------------
+    /**
+     * @brief Values of the first DCCTHREAD_KEYS_INLINE keys.
+     *
+     */
+    void* t_specific[DCCTHREAD_KEYS_INLINE];
+    /**
+     * @brief Values of the other keys, indexed by key - DCCTHREAD_KEYS_INLINE.
+     *
+     */
+    void** t_specific_overflow;
+    unsigned int t_specific_overflow_size;
+    //-------------- Region infos ----------------------------------------------
+    /**
+     * @brief Free space of the current chunk of the `dccthread_alloc` region.
+     *
+     */
+    char* t_region_top;
+    char* t_region_end;
+    /**
+     * @brief The region chunks, from the oldest to the current one, so they
+     * can be handed back to the cache in one go.
+     *
+     */
+    struct region_chunk* t_region;
+    struct region_chunk* t_region_last;
+    int t_region_chunks;
+    /**
+     * @brief Chunks of the requests larger than REGION_LARGE, which are freed
+     * instead of cached.
+     *
+     */
+    struct region_chunk* t_region_large;
+};
+
+/**
+ * @brief A chunk of a `dccthread_alloc` region, followed by its memory.
+ *
+ */
+struct region_chunk {
+    struct region_chunk* next;
+} __attribute__((aligned(REGION_ALIGN)));
+
+/**
+ * @brief A generator. It runs on the stack of its own, switching straight to
+ * and from its consumer.
+ *
+ */
+struct dccthread_gen {
+    ucontext_t ctx;
+    /**
+     * @brief Where the consumer waits for the next value.
+     *
+     */
+    ucontext_t caller;
+    char* stack;
+    void (*func)(void*);
+    void* param;
+    void* value;
+    int done;
+};
+
+/**
+ * @brief Keys for thread specific values, shared by the whole process.
+ *
+ */
+struct key_registry {
+    atomic_uint n_keys;
+    void (*destructors[DCCTHREAD_KEYS_MAX])(void*);
+};
+
+static struct key_registry key_registry;
+
+/**
+ * @brief Memory committed to threads and its limits, shared by the whole
+ * process.
+ *
+ */
+struct mem_accounting {
+    atomic_size_t bytes;
+    atomic_size_t reclaimed;
+    atomic_int threads;
+    size_t max_bytes;
+    int max_threads;
+    int policy;
+    /**
+     * @brief Threads blocked on a limit in any scheduler, and the number of
+     * releases so far, so that a thread about to block can tell it just missed
+     * one.
+     *
+     */
+    atomic_int throttled;
+    atomic_uint releases;
+};
+
+static struct mem_accounting mem_accounting;
+
+/**
+ * @brief A function call handed to the offload pool. It lives on the stack of
+ * the blocked thread until the scheduler makes that thread runnable again.
+ *
+ */
+struct offload_job {
+    void* (*func)(void*);
+    void* arg;
+    void* result;
+    dccthread_t* caller;
+    struct offload_job* next;
+};
+
+/**
+ * @brief The OS threads running offloaded calls, shared by the whole process.
+ *
+ */
+struct offload_pool {
+    pthread_once_t once;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    /**
+     * @brief FIFO of jobs not picked by any OS thread yet.
+     *
+     */
+    struct offload_job* head;
+    struct offload_job* tail;
+    int n_threads;
+};
+
+static struct offload_pool offload_pool = {.once = PTHREAD_ONCE_INIT,
+                                           .lock = PTHREAD_MUTEX_INITIALIZER,
+                                           .cond = PTHREAD_COND_INITIALIZER,
+                                           .n_threads = 4};
+
+/**
+ * @brief A FIFO of the threads parked on the addresses hashed to it.
+ *
+ */
+struct park_bucket {
+    dccthread_t* head;
+    dccthread_t* tail;
+};
+
+/**
+ * @brief Huge page regions thread stacks are carved from, shared by the whole
+ * process.
+ *
+ */
+struct stack_arena {
+    pthread_mutex_t lock;
+    /**
+     * @brief Unused part of the last region.
+     *
+     */
+    char* next;
+    char* end;
+    /**
+     * @brief Stacks of the exited threads, linked through their lowest word.
+     *
+     */
+    char* free_head;
+};
+
+static struct stack_arena stack_arena = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * @brief A profiler sample: the thread that was running and the program
+ * counters of its stack, innermost first.
+ *
+ */
+struct profile_sample {
+    char name[PROFILE_NAME_SIZE];
+    int depth;
+    void* pcs[PROFILE_DEPTH];
+};
+
+/**
+ * @brief The sampling profiler. Samples are written by the signal handler to a
+ * ring allocated when it starts, overwriting the oldest ones once it is full.
+ *
+ */
+struct profiler {
+    int running;
+    timer_t timer_id;
+    struct profile_sample* samples;
+    /**
+     * @brief Samples taken, the ring only keeps the last PROFILE_SAMPLES.
+     *
+     */
+    u_int64_t n_samples;
 };
 
+static struct profiler profiler;
+
 /**
  * @brief A struct that holds all the scheduler main infos.
  *
@@ -80,6 +551,40 @@ struct scheduler {
      *
      */
     sigset_t signals_set;
+    /**
+     * @brief Signal mask the threads run with, the one of the OS thread that
+     * created the scheduler.
+     *
+     */
+    sigset_t thread_mask;
+    //-------------- Critical section infos ------------------------------------
+    /**
+     * @brief Depth of the critical sections being run. Handed over between the
+     * scheduler and the threads on every switch, which always happens inside
+     * one.
+     *
+     */
+    volatile sig_atomic_t in_critical;
+    /**
+     * @brief Pre-emption and timer signals that arrived inside a critical
+     * section, handled when it ends.
+     *
+     */
+    volatile sig_atomic_t preempt_pending;
+    volatile sig_atomic_t timer_pending;
+    //-------------- Signal stack infos ----------------------------------------
+    /**
+     * @brief The pre-empted thread `RESUME_SIGNAL` switches to.
+     *
+     */
+    dccthread_t* resume_thread;
+    /**
+     * @brief Free areas for the floating point state of pre-empted threads,
+     * linked through their first word, and the size of each.
+     *
+     */
+    void* fpstate_free;
+    size_t fpstate_size;
     /**
      * @brief Number of threads waiting for another one.
      *
@@ -91,278 +596,3204 @@ struct scheduler {
      *
      */
     u_int64_t n_exited;
-};
-
-static scheduler_t scheduler;
-
-typedef void (*callback_t)(int);
-
-/**
- * @brief Configures the scheduler timer.
- *
- */
-void configure_timer(void);
-/**
- * @brief Timer handler for thread pre-emption.
- *
- */
-void timer_handler(int);
-/**
- * @brief Function that handle the sleep timer event.
- *
- * @param signo The signal send to the timer event.
- * @param wrapped_info A info wrapper holding the `dccthread_t` that is going to
- * be awaken.
- * @param _
- */
-void sleep_timer_handler(int signo, siginfo_t* wrapped_info, void* _);
-
-/* -------------------------------------------------------------------------- */
-
-void dccthread_init(void (*func)(int), int param) {
-    // Create the list to hold all the threads managed by the scheduler
-    scheduler.threads_list = dlist_create();
-    scheduler.n_waiting = 0;
-    scheduler.n_exited = 0;
-    // Create main thread
-    dccthread_create("main", func, param);
-
-    // Change to the manager thread context and call the scheduler function
-    if(getcontext(&scheduler.ctx) == -1) {
-        printf("Error while getting context\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Configure the timer
-    configure_timer();
-
-    // While there are threads to be computed
-    while(scheduler.threads_list->count) {
-        struct dnode* cur = scheduler.threads_list->head;
-        // Iterate over thread lists
-        while(cur) {
-            dccthread_t* curThread = cur->data;
-            // Only execute RUNNABLE threads (WAITING and SLEEPING are ignored)
-            if(curThread->state < WAITING) {
-                // Set some flags to indicate the current thread being used
-                curThread->state = RUNNING;
-                scheduler.current_thread = curThread;
-
-                // Execute the thread function
-                swapcontext(&scheduler.ctx, &curThread->t_context);
-
-                // If thread was deleted
-                if(scheduler.current_thread != NULL) {
-                    // Reset the flags
-                    scheduler.current_thread = NULL;
-                    // Remove this thread from the list and if the thread hasn't
-                    // finished, puts in the end (least priority)
-                    dlist_remove_from_node(scheduler.threads_list, cur);
-                    if(curThread->state != RUNNING)
-                        dlist_push_right(scheduler.threads_list, curThread);
-                }
-
-                break;
-            }
-
-            cur = cur->next;
-        }
-    }
-    // Delete the timer
-    timer_delete(scheduler.timer_id);
-
-    exit(EXIT_SUCCESS);
+    //-------------- Clock infos -----------------------------------------------
+    /**
+     * @brief Flags the scheduler was initialized with (DCCTHREAD_* flags).
+     *
+     */
+    int flags;
+    /**
+     * @brief The virtual clock, only used when DCCTHREAD_VIRTUAL_TIME is set.
+     *
+     */
+    struct timespec virtual_now;
+    //-------------- Timer infos -----------------------------------------------
+    /**
+     * @brief Binary min-heap of the threads blocked with a timeout, sleepers
+     * included, by wake up time.
+     *
+     */
+    dccthread_t** timers;
+    int n_timers;
+    int timers_size;
+    /**
+     * @brief One shot CLOCK_MONOTONIC timer armed for the top of the timer
+     * heap.
+     *
+     */
+    timer_t precise_timer_id;
+    /**
+     * @brief The time the timer is armed for, zero if disarmed.
+     *
+     */
+    struct timespec precise_next;
+    /**
+     * @brief How long before its deadline a precise sleeper is woken up to
+     * spin.
+     *
+     */
+    struct timespec precise_threshold;
+    //-------------- Inbox infos -----------------------------------------------
+    /**
+     * @brief Lock-free LIFO of threads pushed by other OS threads, drained in a
+     * batch by the scheduler.
+     *
+     */
+    _Atomic(dccthread_t*) inbox_head;
+    /**
+     * @brief Lock-free LIFO of finished offload jobs, drained with the inbox.
+     *
+     */
+    _Atomic(struct offload_job*) offload_done_head;
+    /**
+     * @brief Doorbell eventfd, written when the inbox goes from empty to not
+     * empty (or a thread wakes up) so that an idle scheduler resumes.
+     *
+     */
+    int doorbell_fd;
+    /**
+     * @brief The OS thread running the scheduler, which all the timer signals
+     * are sent to.
+     *
+     */
+    pid_t os_tid;
+    /**
+     * @brief Number of threads blocked on an offloaded call.
+     *
+     */
+    u_int64_t n_offloaded;
+    //-------------- Memory infos ----------------------------------------------
+    /**
+     * @brief Threads blocked on `dccthread_create` until some memory is freed.
+     *
+     */
+    struct dlist* throttled_list;
+    /**
+     * @brief Set when memory is released anywhere in the process while threads
+     * are throttled, so that the oldest throttled thread of this scheduler
+     * tries again on its next pass.
+     *
+     */
+    atomic_int limit_freed;
+    /**
+     * @brief Next scheduler of the registry.
+     *
+     */
+    scheduler_t* next_registered;
+    /**
+     * @brief A thread that has just exited, released by the scheduler once it
+     * is no longer running on its stack.
+     *
+     */
+    dccthread_t* exited_thread;
+    /**
+     * @brief How long a thread must be blocked for its stack to be reclaimed,
+     * and when the next blocked thread gets there.
+     *
+     */
+    struct timespec reclaim_threshold;
+    struct timespec reclaim_next;
+    int reclaim_pending;
+    //-------------- Group infos -----------------------------------------------
+    /**
+     * @brief The group of the threads created without one.
+     *
+     */
+    dccthread_group_t default_group;
+    /**
+     * @brief Number of groups, while it is 1 no time is accounted.
+     *
+     */
+    u_int64_t n_groups;
+    /**
+     * @brief Highest vruntime a group has been dispatched with. Groups that
+     * were idle are brought up to it, so they can't monopolize the CPU to catch
+     * up.
+     *
+     */
+    u_int64_t min_vruntime;
+    //-------------- Deadline infos --------------------------------------------
+    /**
+     * @brief Number of threads on the earliest deadline first class.
+     *
+     */
+    u_int64_t n_edf;
+    /**
+     * @brief Missed deadlines of all the threads, including the exited ones.
+     *
+     */
+    u_int64_t edf_misses;
+    //-------------- Park infos ------------------------------------------------
+    /**
+     * @brief Wait queues of the threads parked on an address, by address hash.
+     *
+     */
+    struct park_bucket park_table[PARK_BUCKETS];
+    //-------------- Dump infos ------------------------------------------------
+    /**
+     * @brief Set by the dump signal, or by the scheduler that registered it,
+     * the scheduler writes its dump on its next pass.
+     *
+     */
+    atomic_int dump_requested;
+    //-------------- Stats infos -----------------------------------------------
+    /**
+     * @brief Number of threads on each state.
+     *
+     */
+    u_int64_t n_states[sizeof(state_names) / sizeof(state_names[0])];
+    u_int64_t n_switches;
+    u_int64_t n_preemptions;
+    u_int64_t idle_ns;
+    /**
+     * @brief Where the counters are published, NULL unless exported.
+     *
+     */
+    struct dccthread_shm_stats* stats;
+    //-------------- Region infos ----------------------------------------------
+    /**
+     * @brief Chunks given back by exited threads, reused by the next regions.
+     *
+     */
+    struct region_chunk* region_cache;
+    int region_cached;
+};
+
+// Each OS thread has its own scheduler, which shares nothing with the others
+static __thread scheduler_t scheduler = {
+    .precise_threshold = {0, 100000},
+    .reclaim_threshold = {1, 0},
+    .default_group = {.weight = DCCTHREAD_DEFAULT_WEIGHT, .vruntime = 0},
+    .n_groups = 1};
+
+/**
+ * @brief The first scheduler created in the process, where
+ * `dccthread_create_remote` sends its threads.
+ *
+ */
+static _Atomic(scheduler_t*) first_scheduler = NULL;
+
+/**
+ * @brief Every scheduler of the process, so that memory released on one can
+ * wake up the threads throttled on the others and a dump signal reaches them
+ * all. A scheduler leaves it when its OS thread exits.
+ *
+ */
+struct sched_registry {
+    pthread_mutex_t lock;
+    pthread_once_t once;
+    pthread_key_t key;
+    scheduler_t* head;
+};
+
+static struct sched_registry sched_registry = {
+    .lock = PTHREAD_MUTEX_INITIALIZER, .once = PTHREAD_ONCE_INIT};
+
+/**
+ * @brief Where `dccthread_dump_on_signal` sends the dumps, shared by the whole
+ * process since the signal may land on any OS thread. The scheduler that
+ * registered it passes the request on to the others.
+ *
+ */
+struct dump_signal {
+    _Atomic(FILE*) out;
+    _Atomic(scheduler_t*) sched;
+};
+
+static struct dump_signal dump_signal;
+
+__thread volatile sig_atomic_t dccthread_yield_requested = 0;
+
+typedef void (*callback_t)(int);
+
+/**
+ * @brief Configures the scheduler timers, leaving the pre-emption one disarmed.
+ *
+ * @return int 0 on success, -1 if a timer couldn't be created.
+ */
+int configure_timer(void);
+/**
+ * @brief Enters a critical section, where the scheduler state may be changed:
+ * the pre-emption and timer signals are only recorded until the section ends.
+ * Sections nest.
+ *
+ */
+static inline void critical_enter(void);
+/**
+ * @brief Leaves a critical section, handling the signals recorded meanwhile
+ * once the outermost one ends.
+ *
+ */
+static inline void critical_exit(void);
+/**
+ * @brief Handles the signals recorded during a critical section.
+ *
+ */
+static void critical_pending(void);
+/**
+ * @brief Dispatches the next runnable thread, if any, until it gives the CPU
+ * back. Must be called inside a critical section.
+ *
+ * @return int 1 if a thread was dispatched, 0 if none was runnable.
+ */
+static int dispatch(void);
+/**
+ * @brief Timer handler for thread pre-emption.
+ *
+ */
+void timer_handler(int signo, siginfo_t* info, void* ucontext);
+/**
+ * @brief Function that handle the timer heap event: wakes up the due threads,
+ * preempting the current thread if a precise sleeper is due.
+ *
+ */
+void precise_timer_handler(int signo, siginfo_t* info, void* ucontext);
+/**
+ * @brief What the pre-emption timer does, wherever it is handled.
+ *
+ * @return int 1 if the current thread must leave the CPU now.
+ */
+static int preempt_tick(void);
+/**
+ * @brief What the timer heap event does, wherever it is handled.
+ *
+ * @return int 1 if the current thread must leave the CPU now.
+ */
+static int precise_tick(void);
+/**
+ * @brief Handles the signals recorded during a critical section.
+ *
+ * @return int 1 if the current thread must leave the CPU now.
+ */
+static int pending_tick(void);
+/**
+ * @brief Switches the current thread out from a signal handler, saving the
+ * interrupted context <uc>.
+ *
+ */
+static void preempt_switch(ucontext_t* uc);
+/**
+ * @brief Switches to a thread switched out by `preempt_switch`, through a
+ * signal whose handler returns into it. Only a signal return restores every
+ * register, `setcontext` only restores the callee saved ones.
+ *
+ */
+static void resume_preempted(dccthread_t* thread);
+#ifdef PREEMPT_FROM_HANDLER
+/**
+ * @brief Size of the floating point state saved by the kernel in a signal
+ * frame, the legacy area plus the extended state described by it.
+ *
+ */
+static size_t fpstate_size(const void* fpstate);
+#endif
+/**
+ * @brief Handler of RESUME_SIGNAL, swaps its own interrupted context for the
+ * one of the thread being resumed.
+ *
+ */
+void resume_handler(int signo, siginfo_t* info, void* ucontext);
+/**
+ * @brief Sets up the stack the scheduler signals are handled on, unless the
+ * OS thread already has one.
+ *
+ * @return int 0 on success, -1 on error.
+ */
+static int signal_stack_create(void);
+/**
+ * @brief Function that handle the profiler timer event, sampling the stack of
+ * the interrupted code.
+ *
+ */
+void profile_handler(int signo, siginfo_t* info, void* ucontext);
+/**
+ * @brief Writes the folded stack line of a sample, without its count.
+ *
+ */
+static void profile_fold(struct profile_sample* sample,
+                         char* line,
+                         size_t size);
+/**
+ * @brief qsort comparator of folded stack lines.
+ *
+ */
+static int profile_line_cmp(const void* a, const void* b);
+/**
+ * @brief Blocks the current thread on <state> until it is woken up or, if
+ * <wake> is not NULL, until <wake> on the scheduler clock. Must be called
+ * inside a critical section.
+ *
+ * @return int 1 if the thread was woken up by the timeout, 0 otherwise, -1 with
+ * errno set to ENOMEM if the timeout couldn't be set up, without blocking.
+ */
+static int block_until(u_int8_t state, const struct timespec* wake);
+/**
+ * @brief Body of `dccthread_wait` and `dccthread_wait_timeout`, with the
+ * critical section entered.
+ *
+ * @return int 1 if the wait timed out, 0 otherwise, -1 if the timeout couldn't
+ * be set up.
+ */
+static int wait_for(dccthread_t* tid, const struct timespec* wake);
+/**
+ * @brief Body of `dccthread_park` and `dccthread_park_timeout`, with the
+ * critical section entered.
+ *
+ * @return int 1 if the park timed out, 0 otherwise, -1 if the timeout couldn't
+ * be set up.
+ */
+static int park(const struct timespec* wake);
+/**
+ * @brief Body of `dccthread_park_on` and `dccthread_park_on_timeout`, with the
+ * critical section entered.
+ *
+ * @return int 0 if the thread was unparked, -1 otherwise.
+ */
+static int park_on(volatile int* addr,
+                   int expected,
+                   const struct timespec* wake);
+/**
+ * @brief Adds <thread> to the timer heap, to be woken up at <wake>.
+ *
+ * @return int 0 on success, -1 if the heap couldn't grow.
+ */
+static int timer_add(dccthread_t* thread, struct timespec wake);
+/**
+ * @brief Removes a thread from the timer heap, if it is in it.
+ *
+ */
+static void timer_remove(dccthread_t* thread);
+/**
+ * @brief Restores the heap order around position <i>.
+ *
+ */
+static void timer_sift(int i);
+/**
+ * @brief Wakes up every thread of the timer heap due at <now>, detaching it
+ * from whatever it was blocked on. Precise sleepers are only woken up when
+ * <precise> is set, and go to the head of the threads list.
+ *
+ * @return int 1 if a thread was woken up.
+ */
+static int timer_expire(struct timespec now, int precise);
+/**
+ * @brief dlist comparator matching a thread by its address.
+ *
+ */
+static int threads_same(const void* e1, const void* e2, void* userdata);
+/**
+ * @brief Arms the timer for the top of the timer heap.
+ *
+ */
+static void timer_arm(void);
+/**
+ * @brief Removes a thread from the wait queue of the address it is parked on.
+ *
+ */
+static void park_unlink(dccthread_t* thread);
+/**
+ * @brief Blocks the current thread until <deadline> on the scheduler clock,
+ * with the precise sleep wake up. Must be called inside a critical section.
+ *
+ * @return int 0 on success, -1 if the wake up couldn't be set up.
+ */
+static int sleep_until(struct timespec deadline);
+/**
+ * @brief Busy waits until <deadline> on CLOCK_MONOTONIC.
+ *
+ */
+static void spin_until(struct timespec deadline);
+/**
+ * @brief Chooses the next thread to be dispatched: the earliest deadline first
+ * threads, then a thread just woken from a precise sleep, then the first
+ * runnable one of the group with the lowest vruntime.
+ *
+ * @return struct dnode* The thread node, or NULL if no thread is runnable.
+ */
+static struct dnode* pick_next(void);
+/**
+ * @brief Brings the current job of an earliest deadline first thread up to
+ * date: counts a missed deadline, throttles it if the budget is over and starts
+ * a new job if its period ended.
+ *
+ * @return int 1 if the thread may run on the earliest deadline first class.
+ */
+static int edf_update(dccthread_t* thread, struct timespec now);
+/**
+ * @brief Starts the job of the period that contains <now>.
+ *
+ */
+static void edf_next_job(struct edf* edf, struct timespec now);
+/**
+ * @brief Returns the wait queue of an address.
+ *
+ */
+static struct park_bucket* park_bucket(volatile int* addr);
+/**
+ * @brief Converts a timespec into nanoseconds.
+ *
+ */
+static u_int64_t timespec_ns(struct timespec ts);
+/**
+ * @brief Creates a thread on <group>. Under DCCTHREAD_LIMIT_BLOCK the caller
+ * waits for room until <wake>, or for as long as it takes if it is NULL.
+ *
+ */
+static dccthread_t* create_in_group(dccthread_group_t* group,
+                                    const char* name,
+                                    void (*func)(int),
+                                    int param,
+                                    const struct timespec* wake);
+/**
+ * @brief Allocates and initializes a thread, without adding it to the threads
+ * list.
+ *
+ */
+static dccthread_t* thread_alloc(scheduler_t* sched,
+                                 const char* name,
+                                 dccthread_group_t* group,
+                                 void (*func)(int),
+                                 int param);
+/**
+ * @brief Initializes a thread whose stack is set and whose context holds a
+ * template saved by getcontext.
+ *
+ */
+static void thread_init(scheduler_t* sched,
+                        dccthread_t* thread,
+                        const char* name,
+                        dccthread_group_t* group,
+                        void (*func)(int),
+                        int param);
+/**
+ * @brief Releases a thread descriptor and its stack, or its share of the batch
+ * they came from.
+ *
+ */
+static void thread_free(dccthread_t* thread);
+/**
+ * @brief Accounts for <threads> new threads if the limits allow it.
+ *
+ * @return int 1 if the threads fit, 0 otherwise.
+ */
+static int mem_reserve(size_t bytes, int threads);
+/**
+ * @brief Gives back what was accounted by `mem_reserve`.
+ *
+ */
+static void mem_release(size_t bytes, int threads);
+/**
+ * @brief Creates the key whose destructor takes a scheduler out of the
+ * registry.
+ *
+ */
+static void sched_registry_init(void);
+/**
+ * @brief Adds the scheduler of the calling OS thread to the registry.
+ *
+ */
+static void sched_register(void);
+/**
+ * @brief Takes <sched> out of the registry, when its OS thread exits.
+ *
+ */
+static void sched_unregister(void* sched);
+/**
+ * @brief Asks every scheduler to let its oldest throttled thread try again,
+ * after memory was released.
+ *
+ */
+static void throttled_notify(void);
+/**
+ * @brief Allocates a thread stack, from the arena when it is enabled.
+ *
+ * @return char* lowest address of the stack, NULL if out of memory.
+ */
+static char* stack_alloc(scheduler_t* sched);
+/**
+ * @brief Frees a stack allocated by `stack_alloc`.
+ *
+ */
+static void stack_free(scheduler_t* sched, char* stack);
+/**
+ * @brief Maps a new 2 MiB region for the stack arena, aligned so it can be
+ * backed by a single huge page.
+ *
+ * @return char* the region, NULL if out of memory.
+ */
+static char* arena_region(void);
+/**
+ * @brief Entry point of every thread: runs its function and exits it if the
+ * function returns.
+ *
+ */
+static void thread_start(void);
+/**
+ * @brief Entry point of every generator: runs its body and goes back to the
+ * consumer for good.
+ *
+ */
+static void gen_start(void);
+/**
+ * @brief Pushes a thread into the scheduler inbox, ringing the doorbell if the
+ * inbox was empty.
+ *
+ */
+static void inbox_push(dccthread_t* thread);
+/**
+ * @brief Applies every request in the scheduler inbox, oldest first.
+ *
+ */
+static void inbox_drain(void);
+/**
+ * @brief Blocks the scheduler until the doorbell rings or the next timeout is
+ * due.
+ *
+ */
+static void wait_doorbell(void);
+/**
+ * @brief Wakes up an idle scheduler.
+ *
+ */
+static void ring_doorbell(scheduler_t* sched);
+/**
+ * @brief Gives back to the OS the stack pages below the saved stack pointer of
+ * the threads blocked for longer than the reclaim threshold.
+ *
+ */
+static void reclaim_stacks(void);
+/**
+ * @brief Reads the program counter, stack pointer and frame pointer of a saved
+ * machine context.
+ *
+ * @return int 1 on success, 0 if the layout is unknown.
+ */
+static int context_regs(mcontext_t* mc,
+                        uintptr_t* pc,
+                        uintptr_t* sp,
+                        uintptr_t* fp);
+/**
+ * @brief Follows the frame pointer chain from <fp>, storing the return
+ * addresses, as long as the frames stay between <sp> and <high>.
+ *
+ * @return int the number of return addresses stored.
+ */
+static int frame_walk(uintptr_t fp,
+                      uintptr_t sp,
+                      uintptr_t high,
+                      void** pcs,
+                      int max);
+/**
+ * @brief Writes the symbol of a code address, or its module and offset.
+ *
+ * @return int the number of characters it wanted to write, as snprintf.
+ */
+static int pc_name(void* pc, char* buf, size_t size);
+/**
+ * @brief Function that handle the dump signal, asking the scheduler that
+ * registered it for a dump on its next pass.
+ *
+ */
+void dump_handler(int);
+/**
+ * @brief Writes the dump asked for by signal. The scheduler that registered the
+ * signal first asks every other scheduler for theirs.
+ *
+ */
+static void dump_signaled(void);
+/**
+ * @brief Writes a thread of the dump: its state and for how long, what it
+ * waits for, its stack usage and its backtrace.
+ *
+ */
+static void dump_thread(FILE* out, dccthread_t* thread, struct timespec now);
+/**
+ * @brief Writes the wait cycles among the threads, each one once.
+ *
+ * @return int the number of cycles found.
+ */
+static int dump_cycles(FILE* out);
+/**
+ * @brief Calls the key destructors for the current thread values and releases
+ * the overflow table.
+ *
+ */
+static void run_key_destructors(void);
+/**
+ * @brief Function that returns the number of keys created so far.
+ *
+ */
+static unsigned int key_count(void);
+/**
+ * @brief Slow path of `dccthread_alloc`: starts a new chunk, or gives the
+ * request a chunk of its own when it is large.
+ *
+ */
+static void* region_grow(dccthread_t* self, size_t size);
+/**
+ * @brief Hands the chunks from <first> to <last> back to the scheduler cache,
+ * or to the OS once the cache is full.
+ *
+ */
+static void region_cache_put(struct region_chunk* first,
+                             struct region_chunk* last,
+                             int n_chunks);
+/**
+ * @brief Releases the whole region of a thread.
+ *
+ */
+static void region_release(dccthread_t* self);
+/**
+ * @brief Moves a thread of this scheduler to <state>, keeping the number of
+ * threads on each state.
+ *
+ */
+static inline void thread_set_state(dccthread_t* thread, u_int8_t state);
+/**
+ * @brief Writes the counters to the exported segment.
+ *
+ */
+static void stats_publish(void);
+/**
+ * @brief Starts the OS threads of the offload pool.
+ *
+ */
+static void offload_pool_start(void);
+/**
+ * @brief Main loop of an offload pool OS thread.
+ *
+ */
+static void* offload_worker(void* _);
+/**
+ * @brief Advances the virtual clock to the earliest wake up of the timer heap
+ * and wakes every thread due.
+ *
+ * @return int 1 if a thread was woken up, 0 if nobody was sleeping.
+ */
+static int advance_virtual_clock(void);
+/**
+ * @brief Adds two timespecs.
+ *
+ */
+static struct timespec timespec_add(struct timespec a, struct timespec b);
+/**
+ * @brief Subtracts <b> from <a>, saturating at zero.
+ *
+ */
+static struct timespec timespec_sub(struct timespec a, struct timespec b);
+/**
+ * @brief Compares two timespecs.
+ *
+ * @return int Negative, zero or positive if <a> is before, equal or after <b>.
+ */
+static int timespec_cmp(struct timespec a, struct timespec b);
+
+/* -------------------------------------------------------------------------- */
+
+void dccthread_init(void (*func)(int), int param) {
+    dccthread_init_flags(func, param, 0);
+}
+
+void dccthread_init_flags(void (*func)(int), int param, int flags) {
+    if(dccthread_sched_create(flags) == -1) {
+        printf("Error while creating the scheduler\n");
+        exit(EXIT_FAILURE);
+    }
+    // Create main thread
+    if(!dccthread_create("main", func, param)) {
+        printf("Error while creating the main thread\n");
+        exit(EXIT_FAILURE);
+    }
+
+    dccthread_sched_run();
+    exit(EXIT_SUCCESS);
+}
+
+int dccthread_sched_run(void) {
+    // The scheduler context is always inside a critical section
+    critical_enter();
+    timer_settime(scheduler.timer_id, 0, &scheduler.timer_interval, NULL);
+
+    // While there are threads to be computed
+    while(scheduler.threads_list->count
+          || atomic_load_explicit(&scheduler.inbox_head,
+                                  memory_order_relaxed)) {
+        if(dispatch()) continue;
+
+        // No thread could run: on virtual time jump straight to the next wake
+        // up. With no timer to jump to, or on real time, sleep until someone
+        // wakes up (an offload, a remote wake, a new thread).
+        if(!(scheduler.flags & DCCTHREAD_VIRTUAL_TIME)
+           || !advance_virtual_clock())
+            wait_doorbell();
+    }
+    // Disarm the timers, the scheduler may get new threads later
+    struct itimerspec disarm = {{0, 0}, {0, 0}};
+    timer_settime(scheduler.timer_id, 0, &disarm, NULL);
+    timer_settime(scheduler.precise_timer_id, 0, &disarm, NULL);
+    scheduler.precise_next = disarm.it_value;
+
+    critical_exit();
+    return 0;
+}
+
+int dccthread_sched_affinity(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) ? -1 : 0;
+}
+
+scheduler_t* dccthread_sched_self(void) {
+    return scheduler.threads_list ? &scheduler : NULL;
+}
+
+int dccthread_sched_create(int flags) {
+    // Create the list to hold all the threads managed by the scheduler
+    scheduler.threads_list = dlist_create();
+    scheduler.n_waiting = 0;
+    scheduler.n_exited = 0;
+    scheduler.flags = flags;
+    scheduler.virtual_now.tv_sec = 0;
+    scheduler.virtual_now.tv_nsec = 0;
+    atomic_init(&scheduler.inbox_head, NULL);
+    atomic_init(&scheduler.offload_done_head, NULL);
+    scheduler.n_offloaded = 0;
+    scheduler.throttled_list = dlist_create();
+    scheduler.exited_thread = NULL;
+    scheduler.os_tid = gettid();
+    scheduler.doorbell_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(scheduler.doorbell_fd == -1) return -1;
+    scheduler_t* none = NULL;
+    atomic_compare_exchange_strong(&first_scheduler, &none, &scheduler);
+    sched_register();
+    if(signal_stack_create() == -1) return -1;
+
+    // Change to the manager thread context and call the scheduler function
+    if(getcontext(&scheduler.ctx) == -1) return -1;
+    scheduler.thread_mask = scheduler.ctx.uc_sigmask;
+
+    // Configure the timer
+    return configure_timer();
+}
+
+int dccthread_run_once(int max_threads, struct timespec budget) {
+    critical_enter();
+    // The pre-emption timer only runs while the threads do
+    timer_settime(scheduler.timer_id, 0, &scheduler.timer_interval, NULL);
+
+    // Whatever rang the doorbell is handled now
+    eventfd_t value;
+    eventfd_read(scheduler.doorbell_fd, &value);
+
+    struct timespec zero = {0, 0};
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end = timespec_add(end, budget);
+
+    int dispatched = 0;
+    int more = 1;
+    while(max_threads <= 0 || dispatched < max_threads) {
+        if(timespec_cmp(budget, zero)) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if(timespec_cmp(now, end) >= 0) break;
+        }
+
+        if(dispatch()) {
+            dispatched++;
+            continue;
+        }
+        // Virtual time can always move on to the next sleeper
+        if(!(scheduler.flags & DCCTHREAD_VIRTUAL_TIME)
+           || !advance_virtual_clock()) {
+            more = 0;
+            break;
+        }
+    }
+
+    struct itimerspec disarm = {{0, 0}, {0, 0}};
+    timer_settime(scheduler.timer_id, 0, &disarm, NULL);
+    // Stopped before running out of threads, so there still is work to do
+    if(more) ring_doorbell(&scheduler);
+
+    critical_exit();
+    return dispatched;
+}
+
+int dccthread_sched_fd(void) { return scheduler.doorbell_fd; }
+
+int dccthread_nthreads(void) { return scheduler.threads_list->count; }
+
+static int dispatch(void) {
+    // Apply what the other OS threads asked for
+    if(atomic_load_explicit(&scheduler.inbox_head, memory_order_relaxed)
+       || atomic_load_explicit(&scheduler.offload_done_head,
+                               memory_order_relaxed)
+       || atomic_load_explicit(&scheduler.limit_freed, memory_order_relaxed))
+        inbox_drain();
+    // A dump asked for by signal is written from here, where nothing runs
+    if(atomic_load_explicit(&scheduler.dump_requested, memory_order_relaxed))
+        dump_signaled();
+    // Wake the due threads, the precise sleepers go to the head so they are
+    // dispatched first. Virtual time only moves when everyone is blocked.
+    if(scheduler.n_timers && !(scheduler.flags & DCCTHREAD_VIRTUAL_TIME)) {
+        timer_expire(dccthread_now(), 1);
+        timer_arm();
+    }
+    if(scheduler.reclaim_pending) reclaim_stacks();
+
+    struct dnode* cur = pick_next();
+    if(!cur) return 0;
+
+    dccthread_t* curThread = cur->data;
+    curThread->t_precise_woken = 0;
+    dccthread_group_t* group = curThread->t_group;
+    struct edf* edf = &curThread->t_edf;
+    struct timespec start;
+    // Only charge the groups when there is more than one
+    int charge_group = scheduler.n_groups > 1;
+    int charge_edf = edf->active;
+    if(charge_group) {
+        if(group->vruntime < scheduler.min_vruntime)
+            group->vruntime = scheduler.min_vruntime;
+        scheduler.min_vruntime = group->vruntime;
+    }
+    if(charge_group || charge_edf) clock_gettime(CLOCK_MONOTONIC, &start);
+    // Make sure the pre-emption comes as soon as the budget is over
+    if(charge_edf && !edf->throttled && timespec_ns(edf->budget)) {
+        u_int64_t left = timespec_ns(edf->budget) - edf->used;
+        if(left < timespec_ns(scheduler.timer_interval.it_interval)) {
+            struct itimerspec time = scheduler.timer_interval;
+            time.it_value.tv_sec = left / 1000000000;
+            time.it_value.tv_nsec = left % 1000000000;
+            timer_settime(scheduler.timer_id, 0, &time, NULL);
+        }
+    }
+
+    // Set some flags to indicate the current thread being used
+    thread_set_state(curThread, RUNNING);
+    scheduler.current_thread = curThread;
+    dccthread_yield_requested = 0;
+    // A fresh quantum, and the thread resumes inside its own critical sections
+    scheduler.preempt_pending = 0;
+    scheduler.in_critical = 1 + curThread->t_preempt_depth;
+
+    // Make sure that when the context is swapped the <func> is called with
+    // <param> parametter
+    if(!curThread->t_started) {
+        curThread->t_started = 1;
+        makecontext(&curThread->t_context, thread_start, 0);
+    }
+    // Execute the thread function
+    if(curThread->t_fpstate) resume_preempted(curThread);
+    else swapcontext(&scheduler.ctx, &curThread->t_context);
+    scheduler.in_critical = 1;
+    scheduler.n_switches++;
+
+    if(charge_group || charge_edf) {
+        struct timespec ran;
+        clock_gettime(CLOCK_MONOTONIC, &ran);
+        u_int64_t ran_ns = timespec_ns(timespec_sub(ran, start));
+        if(charge_group)
+            group->vruntime +=
+                ran_ns * DCCTHREAD_DEFAULT_WEIGHT / group->weight;
+        // Unless it exited meanwhile
+        if(charge_edf && scheduler.current_thread) edf->used += ran_ns;
+    }
+
+    // If thread was deleted
+    if(scheduler.current_thread != NULL) {
+        // Reset the flags
+        scheduler.current_thread = NULL;
+        // Remove this thread from the list and if the thread hasn't
+        // finished, puts in the end (least priority)
+        dlist_unlink(scheduler.threads_list, cur);
+        if(curThread->state != RUNNING)
+            dlist_link_right(scheduler.threads_list, cur);
+        clock_gettime(CLOCK_MONOTONIC, &curThread->t_state_since);
+
+        // Start counting how long it stays blocked
+        if(curThread->state >= WAITING
+           && timespec_ns(scheduler.reclaim_threshold)) {
+            curThread->t_reclaimed = 0;
+            struct timespec due = timespec_add(curThread->t_state_since,
+                                               scheduler.reclaim_threshold);
+            if(!scheduler.reclaim_pending
+               || timespec_cmp(due, scheduler.reclaim_next) < 0)
+                scheduler.reclaim_next = due;
+            scheduler.reclaim_pending = 1;
+        }
+    }
+    // The thread exited, its stack can go now
+    else if(scheduler.exited_thread) {
+        // Lets a throttled thread try again, here or on another scheduler
+        thread_free(scheduler.exited_thread);
+        scheduler.exited_thread = NULL;
+    }
+    if(scheduler.stats) stats_publish();
+    return 1;
+}
+
+dccthread_t* dccthread_create(const char* name, void (*func)(int), int param) {
+    // Threads stay on their creator's group
+    dccthread_group_t* group = scheduler.current_thread
+                                   ? scheduler.current_thread->t_group
+                                   : &scheduler.default_group;
+    return dccthread_create_in_group(group, name, func, param);
+}
+
+dccthread_t* dccthread_create_in_group(dccthread_group_t* group,
+                                       const char* name,
+                                       void (*func)(int),
+                                       int param) {
+    return create_in_group(group, name, func, param, NULL);
+}
+
+dccthread_t* dccthread_create_in_group_timeout(dccthread_group_t* group,
+                                               const char* name,
+                                               void (*func)(int),
+                                               int param,
+                                               struct timespec timeout) {
+    struct timespec wake = timespec_add(dccthread_now(), timeout);
+    return create_in_group(group, name, func, param, &wake);
+}
+
+static dccthread_t* create_in_group(dccthread_group_t* group,
+                                    const char* name,
+                                    void (*func)(int),
+                                    int param,
+                                    const struct timespec* wake) {
+    critical_enter();
+
+    dccthread_t* new_thread;
+    unsigned int releases = atomic_load(&mem_accounting.releases);
+    while(!(new_thread = thread_alloc(&scheduler, name, group, func, param))) {
+        // Only a thread can wait for the memory of the others
+        dccthread_t* self = scheduler.current_thread;
+        if(mem_accounting.policy != DCCTHREAD_LIMIT_BLOCK || !self
+           || scheduler.threads_list->count < 2) {
+            critical_exit();
+            return NULL;
+        }
+        // Counted before looking for a release it missed, so that another OS
+        // thread releasing memory from now on sees it and wakes it up
+        atomic_fetch_add(&mem_accounting.throttled, 1);
+        unsigned int last = atomic_load(&mem_accounting.releases);
+        if(last != releases) {
+            atomic_fetch_sub(&mem_accounting.throttled, 1);
+            releases = last;
+            continue;
+        }
+        dlist_push_right(scheduler.throttled_list, self);
+        int ret = block_until(THROTTLED, wake);
+        if(ret == -1) {
+            dlist_find_remove(
+                scheduler.throttled_list, self, threads_same, NULL);
+            atomic_fetch_sub(&mem_accounting.throttled, 1);
+        }
+        if(ret) {
+            critical_exit();
+            return NULL;
+        }
+        releases = atomic_load(&mem_accounting.releases);
+    }
+
+    // Add this thread to the end of the list of waiting threads, before the
+    // critical section ends so the scheduler never sees the list half updated
+    dlist_link_right(scheduler.threads_list, &new_thread->t_node);
+    scheduler.n_states[RUNNABLE]++;
+    critical_exit();
+    // Created by an embedding host, which may be polling for work
+    if(!scheduler.current_thread) ring_doorbell(&scheduler);
+
+    return new_thread;
+}
+
+dccthread_t* dccthread_create_remote(const char* name,
+                                     void (*func)(int),
+                                     int param) {
+    return dccthread_create_on(
+        atomic_load(&first_scheduler), name, func, param);
+}
+
+dccthread_t* dccthread_create_on(scheduler_t* sched,
+                                 const char* name,
+                                 void (*func)(int),
+                                 int param) {
+    dccthread_t* new_thread =
+        thread_alloc(sched, name, &sched->default_group, func, param);
+    if(!new_thread) return NULL;
+    // The scheduler adds it to the list when draining the inbox
+    new_thread->t_remote_spawn = 1;
+    atomic_store(&new_thread->t_inbox_queued, 1);
+    inbox_push(new_thread);
+
+    return new_thread;
+}
+
+static struct dnode* pick_next(void) {
+    struct dnode* best = NULL;
+    u_int64_t best_vruntime = 0;
+
+    // Earliest deadline first threads come before everyone else
+    if(scheduler.n_edf) {
+        struct timespec now = dccthread_now();
+        for(struct dnode* cur = scheduler.threads_list->head; cur;
+            cur = cur->next) {
+            dccthread_t* t = cur->data;
+            if(!t->t_edf.active) continue;
+            if(!edf_update(t, now) || t->state >= WAITING) continue;
+            if(!best
+               || timespec_cmp(t->t_edf.deadline,
+                               ((dccthread_t*)best->data)->t_edf.deadline)
+                      < 0)
+                best = cur;
+        }
+        if(best) return best;
+    }
+
+    for(struct dnode* cur = scheduler.threads_list->head; cur;
+        cur = cur->next) {
+        dccthread_t* t = cur->data;
+        // Only execute RUNNABLE threads (WAITING and SLEEPING are ignored)
+        if(t->state >= WAITING) continue;
+        // With a single group it is plain round robin
+        if(scheduler.n_groups == 1) return cur;
+        // A precise sleeper was put at the head to run before anyone, whatever
+        // its group owes
+        if(t->t_precise_woken) return cur;
+
+        // The first thread in the list wins a tie, keeping the round robin
+        // inside the group
+        if(!best || t->t_group->vruntime < best_vruntime) {
+            best = cur;
+            best_vruntime = t->t_group->vruntime;
+        }
+    }
+
+    return best;
+}
+
+static int edf_update(dccthread_t* thread, struct timespec now) {
+    struct edf* edf = &thread->t_edf;
+
+    // Its period is over: the unfinished job goes on as the next one
+    if(timespec_ns(edf->period)
+       && timespec_cmp(now, timespec_add(edf->release, edf->period)) >= 0) {
+        if(!edf->missed) {
+            edf->misses++;
+            scheduler.edf_misses++;
+        }
+        edf_next_job(edf, now);
+    }
+    if(!edf->missed && timespec_cmp(now, edf->deadline) > 0) {
+        edf->missed = 1;
+        edf->misses++;
+        scheduler.edf_misses++;
+    }
+    if(timespec_ns(edf->budget) && edf->used >= timespec_ns(edf->budget))
+        edf->throttled = 1;
+
+    return !edf->throttled;
+}
+
+static void edf_next_job(struct edf* edf, struct timespec now) {
+    // Skip the whole periods that went by
+    u_int64_t period = timespec_ns(edf->period);
+    u_int64_t late = timespec_ns(timespec_sub(now, edf->release));
+    u_int64_t skip = late / period * period;
+    struct timespec step = {skip / 1000000000, skip % 1000000000};
+
+    edf->release = timespec_add(edf->release, step);
+    edf->deadline = timespec_add(edf->release, edf->relative_deadline);
+    edf->used = 0;
+    edf->throttled = 0;
+    edf->missed = 0;
+}
+
+static dccthread_t* thread_alloc(scheduler_t* sched,
+                                 const char* name,
+                                 dccthread_group_t* group,
+                                 void (*func)(int),
+                                 int param) {
+    if(!mem_reserve(sizeof(dccthread_t) + THREAD_STACK_SIZE, 1)) return NULL;
+
+    dccthread_t* new_thread = (dccthread_t*)malloc(sizeof(dccthread_t));
+    char* stack = new_thread ? stack_alloc(sched) : NULL;
+    if(!stack) {
+        free(new_thread);
+        mem_release(sizeof(dccthread_t) + THREAD_STACK_SIZE, 1);
+        return NULL;
+    }
+    new_thread->t_stack = stack;
+    new_thread->t_sched = sched;
+    new_thread->t_batch = NULL;
+    // Create a new context and stack
+    if(getcontext(&new_thread->t_context) == -1) {
+        thread_free(new_thread);
+        return NULL;
+    }
+    thread_init(sched, new_thread, name, group, func, param);
+
+    return new_thread;
+}
+
+static void thread_init(scheduler_t* sched,
+                        dccthread_t* thread,
+                        const char* name,
+                        dccthread_group_t* group,
+                        void (*func)(int),
+                        int param) {
+    // Instantiate the thread
+    strcpy(thread->t_name, name);
+    thread->state = RUNNABLE;
+    thread->t_waiting = NULL;
+    thread->t_func = func;
+    thread->t_param = param;
+    thread->t_group = group;
+    thread->t_sched = sched;
+    thread->t_preempt_depth = 0;
+    thread->t_fpstate = NULL;
+    memset(&thread->t_edf, 0, sizeof(thread->t_edf));
+    thread->t_precise = 0;
+    thread->t_precise_woken = 0;
+    thread->t_timer_index = -1;
+    thread->t_timed_out = 0;
+    thread->t_wait_target = NULL;
+    thread->t_inbox_next = NULL;
+    atomic_init(&thread->t_inbox_queued, 0);
+    thread->t_remote_spawn = 0;
+    thread->t_wake_pending = 0;
+    thread->t_park_addr = NULL;
+    thread->t_park_next = NULL;
+    thread->t_gen = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &thread->t_state_since);
+    memset(thread->t_specific, 0, sizeof(thread->t_specific));
+    thread->t_specific_overflow = NULL;
+    thread->t_specific_overflow_size = 0;
+    thread->t_region_top = NULL;
+    thread->t_region_end = NULL;
+    thread->t_region = NULL;
+    thread->t_region_last = NULL;
+    thread->t_region_chunks = 0;
+    thread->t_region_large = NULL;
+
+    thread->t_context.uc_link = &sched->ctx;
+    thread->t_context.uc_stack.ss_sp = thread->t_stack;
+    thread->t_context.uc_stack.ss_size = THREAD_STACK_SIZE;
+    thread->t_context.uc_stack.ss_flags = 0;
+    // Possibly created by another OS thread, with another mask
+    thread->t_context.uc_sigmask = sched->thread_mask;
+
+    thread->t_node.data = thread;
+    thread->t_started = 0;
+}
+
+int dccthread_create_many(int n,
+                          void (*func)(int),
+                          const int* params,
+                          const char* const* names,
+                          dccthread_t** out) {
+    if(n <= 0) return 0;
+    size_t size = sizeof(dccthread_t) + THREAD_STACK_SIZE;
+    if(!mem_reserve(size * n, n)) return -1;
+
+    // One block for the descriptors and, unless the arena provides them, one
+    // for the stacks, released once every thread of the batch exited
+    struct thread_batch* batch = malloc(sizeof(struct thread_batch));
+    dccthread_t* threads = batch ? malloc(n * sizeof(dccthread_t)) : NULL;
+    char* stacks = NULL;
+    if(threads && !(scheduler.flags & DCCTHREAD_STACK_ARENA)) {
+        // Page aligned, so that setting a context up touches a single page
+        stacks = mmap(NULL,
+                      (size_t)n * THREAD_STACK_SIZE,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1,
+                      0);
+        if(stacks == MAP_FAILED) stacks = NULL;
+    }
+    int n_stacks = 0;
+    if(stacks) {
+        n_stacks = n;
+        for(int i = 0; i < n; i++)
+            threads[i].t_stack = stacks + (size_t)i * THREAD_STACK_SIZE;
+    }
+    else if(threads && (scheduler.flags & DCCTHREAD_STACK_ARENA)) {
+        for(; n_stacks < n; n_stacks++) {
+            threads[n_stacks].t_stack = stack_alloc(&scheduler);
+            if(!threads[n_stacks].t_stack) break;
+        }
+    }
+    // A single context is saved, the others are copies of it
+    ucontext_t template;
+    if(n_stacks < n || getcontext(&template) == -1) {
+        if(stacks) munmap(stacks, (size_t)n * THREAD_STACK_SIZE);
+        else
+            for(int i = 0; i < n_stacks; i++)
+                stack_free(&scheduler, threads[i].t_stack);
+        free(threads);
+        free(batch);
+        mem_release(size * n, n);
+        return -1;
+    }
+    batch->threads = threads;
+    batch->stacks = stacks;
+    batch->n_threads = n;
+    batch->live = n;
+
+    dccthread_group_t* group = scheduler.current_thread
+                                   ? scheduler.current_thread->t_group
+                                   : &scheduler.default_group;
+    for(int i = 0; i < n; i++) {
+        dccthread_t* t = &threads[i];
+        char index[DCCTHREAD_MAX_NAME_SIZE];
+        snprintf(index, sizeof(index), "%d", i);
+        t->t_batch = batch;
+        t->t_context = template;
+#if defined(__x86_64__)
+        // The floating point state is saved inside the context itself
+        t->t_context.uc_mcontext.fpregs = &t->t_context.__fpregs_mem;
+#endif
+        thread_init(&scheduler,
+                    t,
+                    names ? names[i] : index,
+                    group,
+                    func,
+                    params ? params[i] : i);
+        if(out) out[i] = t;
+        // Chained beforehand, the whole batch joins the list at once
+        t->t_node.prev = i ? &threads[i - 1].t_node : NULL;
+        t->t_node.next = i + 1 < n ? &threads[i + 1].t_node : NULL;
+    }
+
+    // The whole batch shows up at once
+    critical_enter();
+    dlist_splice_right(scheduler.threads_list,
+                       &threads[0].t_node,
+                       &threads[n - 1].t_node,
+                       n);
+    scheduler.n_states[RUNNABLE] += n;
+    critical_exit();
+    // Created by an embedding host, which may be polling for work
+    if(!scheduler.current_thread) ring_doorbell(&scheduler);
+
+    return 0;
+}
+
+dccthread_group_t* dccthread_sched_group_create(unsigned int weight) {
+    if(!weight) return NULL;
+    dccthread_group_t* group = malloc(sizeof(dccthread_group_t));
+    if(!group) return NULL;
+
+    group->weight = weight;
+    // Start level with the others instead of owing them all their past time
+    group->vruntime = scheduler.min_vruntime;
+    scheduler.n_groups++;
+    return group;
+}
+
+int dccthread_set_deadline(dccthread_t* tid,
+                           struct timespec deadline,
+                           struct timespec period,
+                           struct timespec budget) {
+    struct timespec zero = {0, 0};
+    struct edf* edf = &tid->t_edf;
+
+    critical_enter();
+    // Leave the class
+    if(!timespec_cmp(deadline, zero)) {
+        if(edf->active) scheduler.n_edf--;
+        edf->active = 0;
+        critical_exit();
+        return 0;
+    }
+    if(timespec_cmp(period, zero) && timespec_cmp(deadline, period) > 0) {
+        critical_exit();
+        return -1;
+    }
+
+    if(!edf->active) scheduler.n_edf++;
+    edf->active = 1;
+    edf->relative_deadline = deadline;
+    edf->period = period;
+    edf->budget = budget;
+    // The first job is released right away
+    edf->release = dccthread_now();
+    edf->deadline = timespec_add(edf->release, deadline);
+    edf->used = 0;
+    edf->throttled = 0;
+    edf->missed = 0;
+
+    critical_exit();
+    return 0;
+}
+
+int dccthread_deadline_done(void) {
+    critical_enter();
+
+    dccthread_t* self = scheduler.current_thread;
+    struct edf* edf = &self->t_edf;
+    if(!edf->active) {
+        critical_exit();
+        return 0;
+    }
+
+    // Counts the miss if the job finished past its deadline
+    struct timespec now = dccthread_now();
+    edf_update(self, now);
+
+    // A single job: back to round robin
+    if(!timespec_ns(edf->period)) {
+        edf->active = 0;
+        scheduler.n_edf--;
+        critical_exit();
+        return 0;
+    }
+
+    // Wait for the next release, unless it is late already
+    int ret = 0;
+    struct timespec next = timespec_add(edf->release, edf->period);
+    if(timespec_cmp(next, now) > 0) {
+        edf->release = next;
+        edf->deadline = timespec_add(next, edf->relative_deadline);
+        edf->used = 0;
+        edf->throttled = 0;
+        edf->missed = 0;
+        ret = sleep_until(next);
+    }
+    else {
+        edf_next_job(edf, now);
+    }
+
+    critical_exit();
+    return ret;
+}
+
+int dccthread_deadline_misses(dccthread_t* tid) {
+    return tid ? tid->t_edf.misses : scheduler.edf_misses;
+}
+
+void dccthread_yield(void) {
+    critical_enter();
+    dccthread_yield_requested = 0;
+    thread_set_state(scheduler.current_thread, RUNNABLE);
+    // Swap back to the scheduler context
+    swapcontext(&scheduler.current_thread->t_context, &scheduler.ctx);
+    critical_exit();
+}
+
+void dccthread_exit(void) {
+    // Destructors are user code, so they run before entering the scheduler
+    run_key_destructors();
+
+    critical_enter();
+    // The destructors may still have used the region
+    region_release(scheduler.current_thread);
+    //
+    struct dnode* cur = scheduler.threads_list->head;
+    while(cur) {
+        dccthread_t* t = cur->data;
+        if(t == scheduler.current_thread) {
+            // Make sure to release the waiting threads
+            if(t->t_waiting) {
+                timer_remove(t->t_waiting);
+                t->t_waiting->t_wait_target = NULL;
+                thread_set_state(t->t_waiting, RUNNABLE);
+                scheduler.n_waiting--;
+            }
+            // If this thread is not waited by any other, then it was never
+            // waited. Then, the number of exited threads that has never been
+            // target of the waiting function increases.
+            else {
+                scheduler.n_exited++;
+            }
+
+            if(t->t_edf.active) scheduler.n_edf--;
+            // Removes node from the list
+            dlist_unlink(scheduler.threads_list, cur);
+            scheduler.n_states[RUNNING]--;
+            // The scheduler removes this thread, since its stack is still in
+            // use here
+            scheduler.exited_thread = scheduler.current_thread;
+            scheduler.current_thread = NULL;
+
+            setcontext(&scheduler.ctx);
+            return;
+        }
+        //
+        cur = cur->next;
+    }
+    // Unreachable code
+    puts(
+        "Unreachable piece of code and unexpected error. Look at "
+        "dccthread_exit source code.");
+    exit(EXIT_FAILURE);
+}
+
+void dccthread_wait(dccthread_t* tid) {
+    critical_enter();
+    wait_for(tid, NULL);
+    critical_exit();
+}
+
+int dccthread_wait_timeout(dccthread_t* tid, struct timespec timeout) {
+    critical_enter();
+    struct timespec wake = timespec_add(dccthread_now(), timeout);
+    int timed_out = wait_for(tid, &wake);
+    critical_exit();
+    return timed_out ? -1 : 0;
+}
+
+static int wait_for(dccthread_t* tid, const struct timespec* wake) {
+    // Search for the thread to be awaited
+    struct dnode* cur = scheduler.threads_list->head;
+    while(cur) {
+        dccthread_t* t = cur->data;
+        // If it's the thread to be awaited
+        if(t == tid) {
+            dccthread_t* self = scheduler.current_thread;
+            t->t_waiting = self;
+            self->t_wait_target = t;
+            scheduler.n_waiting++;
+
+            int ret = block_until(WAITING, wake);
+            if(ret == -1) {
+                t->t_waiting = NULL;
+                self->t_wait_target = NULL;
+                scheduler.n_waiting--;
+            }
+            return ret;
+        }
+        //
+        cur = cur->next;
+    }
+    // The thread id doesn't exist, nothing to wait for
+    return 0;
+}
+
+int dccthread_sleep(struct timespec ts) {
+    critical_enter();
+
+    // Blocks the thread from execution until the scheduler wakes it up
+    dccthread_t* self = scheduler.current_thread;
+    self->t_deadline = timespec_add(dccthread_now(), ts);
+    int ret = block_until(SLEEPING, &self->t_deadline) == -1 ? -1 : 0;
+
+    critical_exit();
+    return ret;
+}
+
+struct timespec dccthread_now(void) {
+    if(scheduler.flags & DCCTHREAD_VIRTUAL_TIME) return scheduler.virtual_now;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now;
+}
+
+int dccthread_sleep_precise(struct timespec ts) {
+    critical_enter();
+    int ret = sleep_until(timespec_add(dccthread_now(), ts));
+    critical_exit();
+    return ret;
+}
+
+void dccthread_set_precise_threshold(struct timespec threshold) {
+    scheduler.precise_threshold = threshold;
+}
+
+void dccthread_park(void) {
+    critical_enter();
+    park(NULL);
+    critical_exit();
+}
+
+int dccthread_park_timeout(struct timespec timeout) {
+    critical_enter();
+    struct timespec wake = timespec_add(dccthread_now(), timeout);
+    int timed_out = park(&wake);
+    critical_exit();
+    return timed_out ? -1 : 0;
+}
+
+static int park(const struct timespec* wake) {
+    dccthread_t* self = scheduler.current_thread;
+    // Consume a wake up that arrived before parking
+    if(self->t_wake_pending) {
+        self->t_wake_pending = 0;
+        return 0;
+    }
+    return block_until(PARKED, wake);
+}
+
+void dccthread_wake_remote(dccthread_t* tid) {
+    // Already in the inbox, the pending request wakes it up anyway
+    if(atomic_exchange(&tid->t_inbox_queued, 1)) return;
+    inbox_push(tid);
+}
+
+int dccthread_park_on(volatile int* addr, int expected) {
+    critical_enter();
+    int ret = park_on(addr, expected, NULL);
+    critical_exit();
+    return ret;
+}
+
+int dccthread_park_on_timeout(volatile int* addr,
+                              int expected,
+                              struct timespec timeout) {
+    critical_enter();
+    struct timespec wake = timespec_add(dccthread_now(), timeout);
+    int ret = park_on(addr, expected, &wake);
+    critical_exit();
+    return ret;
+}
+
+static int park_on(volatile int* addr,
+                   int expected,
+                   const struct timespec* wake) {
+    // No other thread runs until the thread is queued, so the value can't
+    // change in between
+    if(*addr != expected) return -1;
+
+    dccthread_t* self = scheduler.current_thread;
+    struct park_bucket* bucket = park_bucket(addr);
+    self->t_park_addr = addr;
+    self->t_park_next = NULL;
+    if(bucket->tail)
+        bucket->tail->t_park_next = self;
+    else
+        bucket->head = self;
+    bucket->tail = self;
+
+    int ret = block_until(PARKED_ON, wake);
+    if(ret == -1) park_unlink(self);
+    return ret ? -1 : 0;
+}
+
+int dccthread_unpark(volatile int* addr, int n) {
+    critical_enter();
+
+    struct park_bucket* bucket = park_bucket(addr);
+    dccthread_t* prev = NULL;
+    dccthread_t* t = bucket->head;
+    int woken = 0;
+    while(t && woken < n) {
+        dccthread_t* next = t->t_park_next;
+        // Other addresses may share the bucket
+        if(t->t_park_addr != addr) {
+            prev = t;
+            t = next;
+            continue;
+        }
+
+        if(prev)
+            prev->t_park_next = next;
+        else
+            bucket->head = next;
+        if(bucket->tail == t) bucket->tail = prev;
+
+        t->t_park_addr = NULL;
+        t->t_park_next = NULL;
+        timer_remove(t);
+        thread_set_state(t, RUNNABLE);
+        woken++;
+        t = next;
+    }
+
+    critical_exit();
+    return woken;
+}
+
+void* dccthread_offload(void* (*func)(void*), void* arg) {
+    critical_enter();
+    // Started inside the critical section so that no other thread can be
+    // scheduled while it is in progress
+    pthread_once(&offload_pool.once, offload_pool_start);
+
+    struct offload_job job;
+    job.func = func;
+    job.arg = arg;
+    job.result = NULL;
+    job.caller = scheduler.current_thread;
+    job.next = NULL;
+
+    // Block before handing the job over: the scheduler only applies the
+    // completion after this thread has been swapped out
+    thread_set_state(job.caller, OFFLOADED);
+    scheduler.n_offloaded++;
+
+    pthread_mutex_lock(&offload_pool.lock);
+    if(offload_pool.tail)
+        offload_pool.tail->next = &job;
+    else
+        offload_pool.head = &job;
+    offload_pool.tail = &job;
+    pthread_cond_signal(&offload_pool.cond);
+    pthread_mutex_unlock(&offload_pool.lock);
+
+    swapcontext(&job.caller->t_context, &scheduler.ctx);
+
+    critical_exit();
+    return job.result;
+}
+
+void dccthread_set_offload_threads(int n) {
+    if(n > 0) offload_pool.n_threads = n;
+}
+
+dccthread_t* dccthread_self(void) { return scheduler.current_thread; }
+
+const char* dccthread_name(dccthread_t* tid) { return tid->t_name; }
+
+dccthread_gen_t* dccthread_gen_create(void (*func)(void*), void* param) {
+    dccthread_gen_t* gen = malloc(sizeof(dccthread_gen_t));
+    if(!gen) return NULL;
+    gen->stack = malloc(THREAD_STACK_SIZE);
+    if(!gen->stack) {
+        free(gen);
+        return NULL;
+    }
+    gen->func = func;
+    gen->param = param;
+    gen->value = NULL;
+    gen->done = 0;
+
+    getcontext(&gen->ctx);
+    gen->ctx.uc_link = NULL;
+    gen->ctx.uc_stack.ss_sp = gen->stack;
+    gen->ctx.uc_stack.ss_size = THREAD_STACK_SIZE;
+    gen->ctx.uc_stack.ss_flags = 0;
+    // It starts on the consuming thread, with the signals a thread runs with
+    // (getcontext kept the caller's when there is no scheduler yet)
+    if(scheduler.threads_list) gen->ctx.uc_sigmask = scheduler.thread_mask;
+    makecontext(&gen->ctx, gen_start, 0);
+
+    return gen;
+}
+
+void* dccthread_gen_next(dccthread_gen_t* gen) {
+    if(gen->done) return NULL;
+
+    // The generator runs as part of this thread, so a pre-emption just
+    // suspends both together
+    dccthread_t* self = scheduler.current_thread;
+    dccthread_gen_t* outer = self->t_gen;
+    self->t_gen = gen;
+    swapcontext(&gen->caller, &gen->ctx);
+    self->t_gen = outer;
+
+    return gen->value;
+}
+
+int dccthread_gen_done(dccthread_gen_t* gen) { return gen->done; }
+
+void dccthread_gen_destroy(dccthread_gen_t* gen) {
+    free(gen->stack);
+    free(gen);
+}
+
+void dccthread_yield_value(void* value) {
+    // Only a generator has a consumer to hand the value to
+    if(!scheduler.current_thread || !scheduler.current_thread->t_gen) return;
+    dccthread_gen_t* gen = scheduler.current_thread->t_gen;
+    gen->value = value;
+    swapcontext(&gen->ctx, &gen->caller);
+}
+
+int dccthread_key_create(dccthread_key_t* key, void (*destructor)(void*)) {
+    unsigned int idx = atomic_fetch_add(&key_registry.n_keys, 1);
+    if(idx >= DCCTHREAD_KEYS_MAX) {
+        atomic_store(&key_registry.n_keys, DCCTHREAD_KEYS_MAX);
+        return -1;
+    }
+
+    key_registry.destructors[idx] = destructor;
+    *key = idx;
+    return 0;
+}
+
+void* dccthread_getspecific(dccthread_key_t key) {
+    dccthread_t* self = scheduler.current_thread;
+    if(key < DCCTHREAD_KEYS_INLINE) return self->t_specific[key];
+
+    key -= DCCTHREAD_KEYS_INLINE;
+    if(key < self->t_specific_overflow_size)
+        return self->t_specific_overflow[key];
+    return NULL;
+}
+
+int dccthread_setspecific(dccthread_key_t key, const void* value) {
+    if(key >= key_count()) return -1;
+
+    dccthread_t* self = scheduler.current_thread;
+    if(key < DCCTHREAD_KEYS_INLINE) {
+        self->t_specific[key] = (void*)value;
+        return 0;
+    }
+
+    key -= DCCTHREAD_KEYS_INLINE;
+    // Grow the overflow table to fit every key created so far
+    if(key >= self->t_specific_overflow_size) {
+        unsigned int size = key_count() - DCCTHREAD_KEYS_INLINE;
+        void** table =
+            realloc(self->t_specific_overflow, size * sizeof(void*));
+        if(!table) return -1;
+        memset(table + self->t_specific_overflow_size,
+               0,
+               (size - self->t_specific_overflow_size) * sizeof(void*));
+        self->t_specific_overflow = table;
+        self->t_specific_overflow_size = size;
+    }
+    self->t_specific_overflow[key] = (void*)value;
+    return 0;
+}
+
+void* dccthread_alloc(size_t size) {
+    dccthread_t* self = scheduler.current_thread;
+    if(!self || size > SIZE_MAX / 2) return NULL;
+
+    // Only the thread itself touches its region, so the fast path needs no
+    // critical section
+    if(!size) size = 1;
+    size = (size + REGION_ALIGN - 1) & ~(size_t)(REGION_ALIGN - 1);
+    if(size <= (size_t)(self->t_region_end - self->t_region_top)) {
+        void* p = self->t_region_top;
+        self->t_region_top += size;
+        return p;
+    }
+
+    critical_enter();
+    void* p = region_grow(self, size);
+    critical_exit();
+    return p;
+}
+
+void dccthread_arena_reset(void) {
+    dccthread_t* self = scheduler.current_thread;
+    if(!self) return;
+
+    critical_enter();
+    struct region_chunk* large = self->t_region_large;
+    while(large) {
+        struct region_chunk* next = large->next;
+        free(large);
+        large = next;
+    }
+    self->t_region_large = NULL;
+
+    // Keep the first chunk, so each request reuses the same memory, and give
+    // the others back. Large allocations alone never took a chunk
+    struct region_chunk* chunk = self->t_region;
+    if(chunk) {
+        if(chunk->next) {
+            region_cache_put(
+                chunk->next, self->t_region_last, self->t_region_chunks - 1);
+            chunk->next = NULL;
+            self->t_region_last = chunk;
+            self->t_region_chunks = 1;
+        }
+        self->t_region_top = (char*)(chunk + 1);
+        self->t_region_end = (char*)chunk + REGION_CHUNK_SIZE;
+    }
+    critical_exit();
+}
+
+static void* region_grow(dccthread_t* self, size_t size) {
+    if(size > REGION_LARGE) {
+        struct region_chunk* large = malloc(sizeof(*large) + size);
+        if(!large) return NULL;
+        large->next = self->t_region_large;
+        self->t_region_large = large;
+        return large + 1;
+    }
+
+    struct region_chunk* chunk = scheduler.region_cache;
+    if(chunk) {
+        scheduler.region_cache = chunk->next;
+        scheduler.region_cached--;
+    }
+    else {
+        chunk = malloc(REGION_CHUNK_SIZE);
+        if(!chunk) return NULL;
+    }
+    // What is left of the previous chunk is wasted
+    chunk->next = NULL;
+    if(self->t_region) self->t_region_last->next = chunk;
+    else self->t_region = chunk;
+    self->t_region_last = chunk;
+    self->t_region_chunks++;
+    self->t_region_top = (char*)(chunk + 1) + size;
+    self->t_region_end = (char*)chunk + REGION_CHUNK_SIZE;
+    return chunk + 1;
+}
+
+static void region_cache_put(struct region_chunk* first,
+                             struct region_chunk* last,
+                             int n_chunks) {
+    if(scheduler.region_cached + n_chunks <= REGION_CACHE_MAX) {
+        last->next = scheduler.region_cache;
+        scheduler.region_cache = first;
+        scheduler.region_cached += n_chunks;
+        return;
+    }
+    while(first) {
+        struct region_chunk* next = first == last ? NULL : first->next;
+        free(first);
+        first = next;
+    }
+}
+
+static void region_release(dccthread_t* self) {
+    while(self->t_region_large) {
+        struct region_chunk* next = self->t_region_large->next;
+        free(self->t_region_large);
+        self->t_region_large = next;
+    }
+    if(self->t_region)
+        region_cache_put(
+            self->t_region, self->t_region_last, self->t_region_chunks);
+    self->t_region = NULL;
+    self->t_region_last = NULL;
+    self->t_region_chunks = 0;
+    self->t_region_top = NULL;
+    self->t_region_end = NULL;
+}
+
+void dccthread_set_limits(size_t max_bytes, int max_threads, int policy) {
+    mem_accounting.max_bytes = max_bytes;
+    mem_accounting.max_threads = max_threads;
+    mem_accounting.policy = policy;
+}
+
+void dccthread_mem_stats(struct dccthread_mem_stats* stats) {
+    stats->bytes = atomic_load(&mem_accounting.bytes);
+    stats->max_bytes = mem_accounting.max_bytes;
+    stats->threads = atomic_load(&mem_accounting.threads);
+    stats->max_threads = mem_accounting.max_threads;
+    stats->reclaimed = atomic_load(&mem_accounting.reclaimed);
+}
+
+void dccthread_set_reclaim_threshold(struct timespec threshold) {
+    scheduler.reclaim_threshold = threshold;
+}
+
+int dccthread_nwaiting() { return scheduler.n_waiting; }
+
+int dccthread_noffloaded() { return scheduler.n_offloaded; }
+
+int dccthread_profile_start(int hz) {
+    if(profiler.running || hz <= 0) return -1;
+
+    profiler.samples = malloc(PROFILE_SAMPLES * sizeof(struct profile_sample));
+    if(!profiler.samples) return -1;
+    profiler.n_samples = 0;
+
+    struct sigaction sa;
+    sa.sa_sigaction = profile_handler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+    sa.sa_mask = scheduler.signals_set;
+    sigaction(PROFILE_SIGNAL, &sa, NULL);
+
+    // Measures the CPU time of the scheduler OS thread, which is the caller
+    struct sigevent sev;
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_notify_thread_id = scheduler.os_tid;
+    sev.sigev_signo = PROFILE_SIGNAL;
+    sev.sigev_value.sival_ptr = &profiler.timer_id;
+    if(timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &profiler.timer_id) == -1) {
+        free(profiler.samples);
+        return -1;
+    }
+
+    u_int64_t interval = 1000000000 / hz;
+    struct itimerspec time;
+    time.it_interval.tv_sec = interval / 1000000000;
+    time.it_interval.tv_nsec = interval % 1000000000;
+    time.it_value = time.it_interval;
+    profiler.running = 1;
+    timer_settime(profiler.timer_id, 0, &time, NULL);
+
+    return 0;
+}
+
+int dccthread_profile_stop(FILE* out) {
+    if(!profiler.running) return -1;
+
+    timer_delete(profiler.timer_id);
+    profiler.running = 0;
+
+    int n = profiler.n_samples < PROFILE_SAMPLES ? profiler.n_samples
+                                                 : PROFILE_SAMPLES;
+    size_t line_size = PROFILE_NAME_SIZE + PROFILE_DEPTH * 256;
+    char** lines = malloc(n * sizeof(char*));
+    int n_lines = 0;
+    for(; lines && n_lines < n; n_lines++) {
+        lines[n_lines] = malloc(line_size);
+        if(!lines[n_lines]) break;
+        profile_fold(&profiler.samples[n_lines], lines[n_lines], line_size);
+    }
+    if(n_lines < n) {
+        for(int i = 0; i < n_lines; i++) free(lines[i]);
+        free(lines);
+        free(profiler.samples);
+        profiler.samples = NULL;
+        return -1;
+    }
+
+    // Equal stacks end up next to each other and are written once
+    qsort(lines, n, sizeof(char*), profile_line_cmp);
+    for(int i = 0, count = 1; i < n; i++, count++) {
+        if(i + 1 < n && !strcmp(lines[i], lines[i + 1])) continue;
+        fprintf(out, "%s %d\n", lines[i], count);
+        count = 0;
+    }
+
+    for(int i = 0; i < n; i++) free(lines[i]);
+    free(lines);
+    free(profiler.samples);
+    profiler.samples = NULL;
+
+    return n;
+}
+
+void dccthread_dump(FILE* out) {
+    critical_enter();
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fprintf(out,
+            "dccthread dump: %d threads, %lu waiting, OS thread %d\n",
+            scheduler.threads_list->count,
+            (unsigned long)scheduler.n_waiting,
+            (int)scheduler.os_tid);
+    for(struct dnode* cur = scheduler.threads_list->head; cur;
+        cur = cur->next)
+        dump_thread(out, cur->data, now);
+    dump_cycles(out);
+    fflush(out);
+
+    critical_exit();
+}
+
+int dccthread_dump_on_signal(int signo, FILE* out) {
+    atomic_store(&dump_signal.out, out);
+    atomic_store(&dump_signal.sched, &scheduler);
+    struct sigaction sa;
+    sa.sa_handler = dump_handler;
+    sa.sa_flags = SA_RESTART | SA_ONSTACK;
+    sa.sa_mask = scheduler.signals_set;
+    return sigaction(signo, &sa, NULL);
+}
+
+void dump_handler(int signo) {
+    // Delivered to some OS thread of the process, which may have no scheduler,
+    // so it goes to the one that registered the signal
+    scheduler_t* sched = atomic_load(&dump_signal.sched);
+    if(!sched) return;
+    atomic_store(&sched->dump_requested, 1);
+    // The scheduler may be idle
+    ring_doorbell(sched);
+}
+
+static void dump_signaled(void) {
+    atomic_store(&scheduler.dump_requested, 0);
+    FILE* out = atomic_load(&dump_signal.out);
+    if(!out) return;
+
+    if(atomic_load(&dump_signal.sched) == &scheduler) {
+        pthread_mutex_lock(&sched_registry.lock);
+        for(scheduler_t* s = sched_registry.head; s; s = s->next_registered) {
+            if(s == &scheduler) continue;
+            atomic_store(&s->dump_requested, 1);
+            ring_doorbell(s);
+        }
+        pthread_mutex_unlock(&sched_registry.lock);
+    }
+    // Each scheduler writes its dump in one piece
+    flockfile(out);
+    dccthread_dump(out);
+    funlockfile(out);
+}
+
+static void dump_thread(FILE* out, dccthread_t* thread, struct timespec now) {
+    uintptr_t low = (uintptr_t)thread->t_stack;
+    uintptr_t high = low + THREAD_STACK_SIZE;
+    uintptr_t pc = 0, sp = 0, fp = 0;
+    fprintf(
+        out, "thread \"%s\" %s", thread->t_name, state_names[thread->state]);
+    // The saved context of the running thread is stale, walk the live stack
+    if(thread == scheduler.current_thread) {
+        sp = fp = (uintptr_t)__builtin_frame_address(0);
+    }
+    // Never ran, its context still isn't on its stack
+    else if(!thread->t_started) {
+        pc = (uintptr_t)thread_start;
+    }
+    else {
+        context_regs(&thread->t_context.uc_mcontext, &pc, &sp, &fp);
+        fprintf(out,
+                " for %.3fms",
+                timespec_ns(timespec_sub(now, thread->t_state_since)) / 1e6);
+    }
+    // Inside a generator the thread runs on another stack
+    int on_stack = sp > low && sp <= high;
+    if(on_stack)
+        fprintf(out,
+                ", stack %lu/%d bytes",
+                (unsigned long)(high - sp),
+                THREAD_STACK_SIZE);
+    fputc('\n', out);
+
+    if(thread->state == WAITING && thread->t_wait_target)
+        fprintf(out, "    waits for \"%s\"\n", thread->t_wait_target->t_name);
+    if(thread->state == PARKED_ON)
+        fprintf(out, "    parked on %p\n", (void*)thread->t_park_addr);
+    if(thread->t_timer_index >= 0) {
+        struct timespec left =
+            timespec_sub(thread->t_timer_at, dccthread_now());
+        fprintf(out, "    times out in %.3fms\n", timespec_ns(left) / 1e6);
+    }
+
+    void* pcs[PROFILE_DEPTH];
+    int depth = 0;
+    if(pc) pcs[depth++] = (void*)pc;
+    if(on_stack)
+        depth += frame_walk(fp, sp, high, pcs + depth, PROFILE_DEPTH - depth);
+    for(int i = 0; i < depth; i++) {
+        // Return addresses point past the call, look up the call itself
+        char name[256];
+        pc_name((char*)pcs[i] - (i > 0 || !pc), name, sizeof(name));
+        fprintf(out, "    #%d %s\n", i, name);
+    }
+}
+
+static int dump_cycles(FILE* out) {
+    int n_threads = scheduler.threads_list->count;
+    int cycles = 0;
+    for(struct dnode* cur = scheduler.threads_list->head; cur;
+        cur = cur->next) {
+        dccthread_t* t = cur->data;
+        // Follow the wait chain, at most once around all the threads
+        dccthread_t* u = t;
+        int steps = 0;
+        do {
+            u = u->state == WAITING ? u->t_wait_target : NULL;
+        } while(u && u != t && ++steps < n_threads);
+        if(u != t) continue;
+
+        // Only the member with the lowest address writes the cycle
+        int lowest = 1;
+        for(u = t->t_wait_target; u != t; u = u->t_wait_target)
+            if((uintptr_t)u < (uintptr_t)t) lowest = 0;
+        if(!lowest) continue;
+
+        fprintf(out, "wait cycle: \"%s\"", t->t_name);
+        u = t;
+        do {
+            u = u->t_wait_target;
+            fprintf(out, " -> \"%s\"", u->t_name);
+        } while(u != t);
+        fputc('\n', out);
+        cycles++;
+    }
+    return cycles;
+}
+
+int dccthread_nexited() { return scheduler.n_exited; }
+
+int dccthread_stats_export(const char* name) {
+    if(!scheduler.threads_list) return -1;
+
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if(fd == -1) return -1;
+    size_t size = sizeof(struct dccthread_shm_stats);
+    if(ftruncate(fd, size) == -1) {
+        close(fd);
+        return -1;
+    }
+    struct dccthread_shm_stats* shm =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(shm == MAP_FAILED) return -1;
+
+    // Readers may already have the segment of a previous run open
+    shm->seq |= 1;
+    atomic_thread_fence(memory_order_release);
+    shm->magic = DCCTHREAD_STATS_MAGIC;
+    shm->version = DCCTHREAD_STATS_VERSION;
+    shm->pid = getpid();
+    shm->os_tid = scheduler.os_tid;
+
+    critical_enter();
+    scheduler.stats = shm;
+    stats_publish();
+    critical_exit();
+    return 0;
+}
+
+static inline void thread_set_state(dccthread_t* thread, u_int8_t state) {
+    scheduler.n_states[thread->state]--;
+    scheduler.n_states[state]++;
+    thread->state = state;
+}
+
+static void stats_publish(void) {
+    struct dccthread_shm_stats* shm = scheduler.stats;
+    // Only this OS thread writes, so the sequence can't change under it. It
+    // is odd while the counters are being written.
+    u_int64_t seq = (shm->seq | 1) + 1;
+    shm->seq = seq - 1;
+    atomic_thread_fence(memory_order_release);
+
+    shm->live = scheduler.threads_list->count;
+    shm->running = scheduler.n_states[RUNNING];
+    shm->runnable = scheduler.n_states[RUNNABLE];
+    shm->waiting = scheduler.n_states[WAITING];
+    shm->sleeping = scheduler.n_states[SLEEPING];
+    shm->parked = scheduler.n_states[PARKED] + scheduler.n_states[PARKED_ON];
+    shm->offloaded = scheduler.n_states[OFFLOADED];
+    shm->throttled = scheduler.n_states[THROTTLED];
+    shm->exited = scheduler.n_exited;
+    shm->switches = scheduler.n_switches;
+    shm->preemptions = scheduler.n_preemptions;
+    shm->idle_ns = scheduler.idle_ns;
+
+    atomic_thread_fence(memory_order_release);
+    shm->seq = seq;
+}
+
+int configure_timer() {
+    // Initializes signs blockers for timers
+    sigemptyset(&scheduler.signals_set);
+    sigaddset(&scheduler.signals_set, PRE_EMPTION_SIG);
+    sigaddset(&scheduler.signals_set, PRECISE_SIGNAL);
+    // Define timer signal event
+    scheduler.sev.sigev_value.sival_ptr = &scheduler.timer_id;
+    // Timer signals go to the scheduler OS thread only, never to the other
+    // threads of the process
+    scheduler.sev.sigev_notify = SIGEV_THREAD_ID;
+    scheduler.sev.sigev_notify_thread_id = scheduler.os_tid;
+    scheduler.sev.sigev_signo = PRE_EMPTION_SIG;
+    // Defines action on signal detection
+    scheduler.sa.sa_sigaction = timer_handler;
+    // The signals may also reach an embedding host, don't break its syscalls.
+    // No handler may interrupt another one that switches threads.
+    scheduler.sa.sa_flags = SA_SIGINFO | SA_RESTART | SWITCH_SIGNAL_FLAGS;
+    scheduler.sa.sa_mask = scheduler.signals_set;
+    sigaction(PRE_EMPTION_SIG, &scheduler.sa, NULL);
+    struct sigaction resume;
+    resume.sa_sigaction = resume_handler;
+    resume.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    resume.sa_mask = scheduler.signals_set;
+    sigaction(RESUME_SIGNAL, &resume, NULL);
+    // Create timer
+    // Only the CPU time of this OS thread counts, the others have their own
+    // schedulers
+    if(timer_create(
+           CLOCK_THREAD_CPUTIME_ID, &scheduler.sev, &scheduler.timer_id)
+       == -1)
+        return -1;
+
+    // Define timer interval of 10ms, it is started with the dispatching
+    scheduler.timer_interval.it_interval.tv_nsec = 10000000;
+    scheduler.timer_interval.it_interval.tv_sec = 0;
+    scheduler.timer_interval.it_value = scheduler.timer_interval.it_interval;
+
+    // Create the precise sleep timer, armed only when there are sleepers
+    struct sigevent sev;
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_notify_thread_id = scheduler.os_tid;
+    sev.sigev_signo = PRECISE_SIGNAL;
+    sev.sigev_value.sival_ptr = &scheduler.precise_timer_id;
+    struct sigaction sa;
+    sa.sa_sigaction = precise_timer_handler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART | SWITCH_SIGNAL_FLAGS;
+    sa.sa_mask = scheduler.signals_set;
+    sigaction(PRECISE_SIGNAL, &sa, NULL);
+    if(timer_create(CLOCK_MONOTONIC, &sev, &scheduler.precise_timer_id)
+       == -1)
+        return -1;
+
+    return 0;
+}
+
+void timer_handler(int signo, siginfo_t* info, void* ucontext) {
+    if(preempt_tick()) preempt_switch(ucontext);
+}
+
+static int preempt_tick(void) {
+    // An embedding host may be running instead of a thread
+    if(!scheduler.current_thread) return 0;
+    // On cooperative mode the thread stops itself at its next checkpoint
+    if(scheduler.flags & DCCTHREAD_COOPERATIVE) {
+        dccthread_yield_requested = 1;
+        return 0;
+    }
+    // The scheduler state may be half updated, yield once it is consistent
+    if(scheduler.in_critical) {
+        scheduler.preempt_pending = 1;
+        return 0;
+    }
+    // Stops the current thread
+    return 1;
+}
+
+static inline void critical_enter(void) {
+    scheduler.in_critical++;
+    // Only the signal handlers of this OS thread look at the counter, so
+    // keeping the compiler from moving the accesses around is enough
+    atomic_signal_fence(memory_order_seq_cst);
+}
+
+static inline void critical_exit(void) {
+    atomic_signal_fence(memory_order_seq_cst);
+    if(--scheduler.in_critical) return;
+    if(__builtin_expect(scheduler.preempt_pending | scheduler.timer_pending, 0))
+        critical_pending();
+}
+
+static void critical_pending(void) {
+    if(!pending_tick()) return;
+    scheduler.n_preemptions++;
+    dccthread_yield();
+}
+
+static int pending_tick(void) {
+    int leave = 0;
+    if(scheduler.timer_pending) {
+        scheduler.timer_pending = 0;
+        leave = precise_tick();
+    }
+    if(scheduler.preempt_pending) {
+        scheduler.preempt_pending = 0;
+        leave |= preempt_tick();
+    }
+    return leave;
+}
+
+static void preempt_switch(ucontext_t* uc) {
+#ifdef PREEMPT_FROM_HANDLER
+    dccthread_t* self = scheduler.current_thread;
+    // The floating point state is in the signal frame, which is about to be
+    // dropped
+    const char* fpstate = (const char*)uc->uc_mcontext.fpregs;
+    size_t size = fpstate_size(fpstate);
+    if(!scheduler.fpstate_size) scheduler.fpstate_size = (size + 63) & ~63;
+    if(size > scheduler.fpstate_size) return;
+    if(!scheduler.fpstate_free) {
+        char* chunk = mmap(NULL,
+                           FPSTATE_CHUNK_SIZE,
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS,
+                           -1,
+                           0);
+        // Keeps running, another tick will come
+        if(chunk == MAP_FAILED) return;
+        for(size_t off = 0; off + scheduler.fpstate_size <= FPSTATE_CHUNK_SIZE;
+            off += scheduler.fpstate_size) {
+            *(void**)(chunk + off) = scheduler.fpstate_free;
+            scheduler.fpstate_free = chunk + off;
+        }
+    }
+    self->t_fpstate = scheduler.fpstate_free;
+    scheduler.fpstate_free = *(void**)self->t_fpstate;
+    memcpy(self->t_fpstate, fpstate, size);
+
+    self->t_context.uc_mcontext = uc->uc_mcontext;
+    self->t_context.uc_mcontext.fpregs = self->t_fpstate;
+    self->t_context.uc_sigmask = uc->uc_sigmask;
+    critical_enter();
+    scheduler.n_preemptions++;
+    dccthread_yield_requested = 0;
+    thread_set_state(self, RUNNABLE);
+    // Never comes back here, the thread is resumed by `resume_handler`
+    setcontext(&scheduler.ctx);
+#else
+    // Installed without SA_ONSTACK here, so the handler runs on the thread
+    // stack, which keeps the signal frame while the thread is switched out
+    scheduler.n_preemptions++;
+    dccthread_yield();
+#endif
 }
 
-dccthread_t* dccthread_create(const char* name, void (*func)(int), int param) {
-    dccthread_t* new_thread = (dccthread_t*)malloc(sizeof(dccthread_t));
-    // Instantiate the thread
-    strcpy(new_thread->t_name, name);
-    new_thread->state = RUNNABLE;
-    new_thread->t_waiting = NULL;
-    // Create a new context and stack
-    if(getcontext(&new_thread->t_context) == -1) {
-        puts("Error while getting context...exiting\n");
-        exit(EXIT_FAILURE);
+static void resume_preempted(dccthread_t* thread) {
+    // The thread comes back to the scheduler through this context
+    volatile int resumed = 0;
+    getcontext(&scheduler.ctx);
+    if(resumed) return;
+    resumed = 1;
+    scheduler.resume_thread = thread;
+    tgkill(getpid(), scheduler.os_tid, RESUME_SIGNAL);
+}
+
+void resume_handler(int signo, siginfo_t* info, void* ucontext) {
+#ifdef PREEMPT_FROM_HANDLER
+    ucontext_t* uc = ucontext;
+    dccthread_t* thread = scheduler.resume_thread;
+    memcpy(uc->uc_mcontext.gregs,
+           thread->t_context.uc_mcontext.gregs,
+           sizeof(gregset_t));
+    memcpy(uc->uc_mcontext.fpregs,
+           thread->t_fpstate,
+           fpstate_size(thread->t_fpstate));
+    uc->uc_sigmask = thread->t_context.uc_sigmask;
+    *(void**)thread->t_fpstate = scheduler.fpstate_free;
+    scheduler.fpstate_free = thread->t_fpstate;
+    thread->t_fpstate = NULL;
+
+    // It was pre-empted outside of any critical section, where it resumes.
+    // What was recorded since the dispatch is handled as if it came now.
+    scheduler.in_critical = 0;
+    if(pending_tick()) preempt_switch(uc);
+#endif
+}
+
+#ifdef PREEMPT_FROM_HANDLER
+static size_t fpstate_size(const void* fpstate) {
+    // The magic number, then the size including the trailing magic number
+    const u_int32_t* sw =
+        (const u_int32_t*)((const char*)fpstate + XSTATE_SW_OFFSET);
+    return sw[0] == XSTATE_MAGIC ? sw[1] : sizeof(struct _libc_fpstate);
+}
+#endif
+
+static int signal_stack_create(void) {
+    stack_t ss;
+    if(sigaltstack(NULL, &ss) == -1) return -1;
+    if(!(ss.ss_flags & SS_DISABLE)) return 0;
+
+    ss.ss_size = SIGNAL_STACK_SIZE + SIGSTKSZ;
+    ss.ss_sp = mmap(NULL,
+                    ss.ss_size,
+                    PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1,
+                    0);
+    if(ss.ss_sp == MAP_FAILED) return -1;
+    ss.ss_flags = 0;
+    return sigaltstack(&ss, NULL);
+}
+
+void dccthread_preempt_disable(void) {
+    critical_enter();
+    scheduler.current_thread->t_preempt_depth++;
+}
+
+void dccthread_preempt_enable(void) {
+    scheduler.current_thread->t_preempt_depth--;
+    critical_exit();
+}
+
+void profile_handler(int signo, siginfo_t* info, void* ucontext) {
+    if(!profiler.running) return;
+
+    uintptr_t pc, sp, fp;
+    if(!context_regs(&((ucontext_t*)ucontext)->uc_mcontext, &pc, &sp, &fp))
+        return;
+
+    struct profile_sample* sample =
+        &profiler.samples[profiler.n_samples % PROFILE_SAMPLES];
+    sample->pcs[0] = (void*)pc;
+    sample->depth = 1;
+
+    // Only a stack pointer inside the thread stack, or the stack of the
+    // generator it is running, means the thread itself was interrupted,
+    // otherwise it is the scheduler
+    dccthread_t* thread = scheduler.current_thread;
+    uintptr_t low = 0, high = 0;
+    if(thread && thread->t_gen) {
+        low = (uintptr_t)thread->t_gen->stack;
+        high = low + THREAD_STACK_SIZE;
+    }
+    if(thread && (sp < low || sp >= high)) {
+        low = (uintptr_t)thread->t_stack;
+        high = low + THREAD_STACK_SIZE;
     }
-    char* stack = (char*)malloc(THREAD_STACK_SIZE * sizeof(char));
-    new_thread->t_context.uc_link = &scheduler.ctx;
-    new_thread->t_context.uc_stack.ss_sp = stack;
-    new_thread->t_context.uc_stack.ss_size = THREAD_STACK_SIZE;
-    new_thread->t_context.uc_stack.ss_flags = 0;
-    sigemptyset(&new_thread->t_context.uc_sigmask);
-    sigprocmask(SIG_UNBLOCK, &scheduler.ctx.uc_sigmask, NULL);
+    if(!thread || sp < low || sp >= high) {
+        strcpy(sample->name, "[scheduler]");
+        profiler.n_samples++;
+        return;
+    }
+    strncpy(sample->name, thread->t_name, PROFILE_NAME_SIZE - 1);
+    sample->name[PROFILE_NAME_SIZE - 1] = '\0';
 
-    // Make sure that when the context is swapped the <func> is called with
-    // <param> parametter
-    makecontext(&new_thread->t_context, (void (*)())func, 1, param);
-    // Add this thread to the end of the list of waiting threads
-    dlist_push_right(scheduler.threads_list, new_thread);
+    sample->depth +=
+        frame_walk(fp, sp, high, sample->pcs + 1, PROFILE_DEPTH - 1);
+    profiler.n_samples++;
+}
 
-    return new_thread;
+static void profile_fold(struct profile_sample* sample,
+                         char* line,
+                         size_t size) {
+    size_t len = snprintf(line, size, "%s", sample->name);
+    // Semicolons and spaces are separators in the folded format
+    for(char* c = line; *c; c++)
+        if(*c == ';' || *c == ' ') *c = '_';
+
+    for(int i = sample->depth - 1; i >= 0 && len < size; i--) {
+        // Return addresses point past the call, look up the call itself
+        void* pc = (char*)sample->pcs[i] - (i > 0);
+        len += snprintf(line + len, size - len, ";");
+        if(len < size) len += pc_name(pc, line + len, size - len);
+    }
 }
 
-void dccthread_yield(void) {
-    sigprocmask(SIG_BLOCK, &scheduler.signals_set, NULL);
-    scheduler.current_thread->state = RUNNABLE;
-    // Swap back to the scheduler context
-    swapcontext(&scheduler.current_thread->t_context, &scheduler.ctx);
-    sigprocmask(SIG_UNBLOCK, &scheduler.signals_set, NULL);
+static int pc_name(void* pc, char* buf, size_t size) {
+    Dl_info dl;
+    int found = dladdr(pc, &dl);
+    if(found && dl.dli_sname) return snprintf(buf, size, "%s", dl.dli_sname);
+    if(found && dl.dli_fname) {
+        const char* base = strrchr(dl.dli_fname, '/');
+        return snprintf(buf,
+                        size,
+                        "%s+0x%lx",
+                        base ? base + 1 : dl.dli_fname,
+                        (unsigned long)((char*)pc - (char*)dl.dli_fbase));
+    }
+    return snprintf(buf, size, "%p", pc);
 }
 
-void dccthread_exit(void) {
-    sigprocmask(SIG_BLOCK, &scheduler.signals_set, NULL);
-    //
-    struct dnode* cur = scheduler.threads_list->head;
-    while(cur) {
-        dccthread_t* t = cur->data;
-        if(t == scheduler.current_thread) {
-            // Make sure to release the waiting threads
-            if(t->t_waiting) {
-                t->t_waiting->state = RUNNABLE;
-                scheduler.n_waiting--;
-            }
-            // If this thread is not waited by any other, then it was never
-            // waited. Then, the number of exited threads that has never been
-            // target of the waiting function increases.
-            else {
-                scheduler.n_exited++;
+static int profile_line_cmp(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+void precise_timer_handler(int signo, siginfo_t* info, void* ucontext) {
+    if(precise_tick()) preempt_switch(ucontext);
+}
+
+static int precise_tick(void) {
+    // The timer heap may be half updated, come back once it is consistent
+    if(scheduler.in_critical) {
+        scheduler.timer_pending = 1;
+        return 0;
+    }
+    // The signal may have been pending while the scheduler already woke the
+    // threads, or the timer armed for one that was woken up earlier
+    if(!scheduler.n_timers) return 0;
+    struct timespec now = dccthread_now();
+    if(timespec_cmp(scheduler.timers[0]->t_timer_at, now) > 0) {
+        timer_arm();
+        return 0;
+    }
+    // Nobody to preempt, an embedding host has to be told instead
+    if(!scheduler.current_thread) {
+        ring_doorbell(&scheduler);
+        return 0;
+    }
+
+    // The others only need to become runnable, but a precise sleeper must be
+    // dispatched right away
+    timer_expire(now, 0);
+    if(!scheduler.n_timers
+       || timespec_cmp(scheduler.timers[0]->t_timer_at, now) > 0) {
+        timer_arm();
+        return 0;
+    }
+    if(scheduler.flags & DCCTHREAD_COOPERATIVE) {
+        dccthread_yield_requested = 1;
+        return 0;
+    }
+    return 1;
+}
+
+#ifdef DCCTHREAD_INSTRUMENT
+// Hooks called by code built with -finstrument-functions. Only the running
+// thread may yield, never the scheduler itself.
+void __cyg_profile_func_enter(void* func, void* caller)
+    __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void* func, void* caller)
+    __attribute__((no_instrument_function));
+
+void __cyg_profile_func_enter(void* func, void* caller) {
+    if(dccthread_yield_requested && scheduler.current_thread) dccthread_yield();
+}
+
+void __cyg_profile_func_exit(void* func, void* caller) {}
+#endif
+
+static int block_until(u_int8_t state, const struct timespec* wake) {
+    dccthread_t* self = scheduler.current_thread;
+    if(wake && timer_add(self, *wake) == -1) {
+        errno = ENOMEM;
+        return -1;
+    }
+    thread_set_state(self, state);
+    self->t_timed_out = 0;
+
+    swapcontext(&self->t_context, &scheduler.ctx);
+    return self->t_timed_out;
+}
+
+static int timer_add(dccthread_t* thread, struct timespec wake) {
+    if(scheduler.n_timers == scheduler.timers_size) {
+        int size = scheduler.timers_size ? scheduler.timers_size * 2 : 64;
+        dccthread_t** timers =
+            realloc(scheduler.timers, size * sizeof(dccthread_t*));
+        if(!timers) return -1;
+        scheduler.timers = timers;
+        scheduler.timers_size = size;
+    }
+
+    thread->t_timer_at = wake;
+    thread->t_timer_index = scheduler.n_timers;
+    scheduler.timers[scheduler.n_timers++] = thread;
+    timer_sift(thread->t_timer_index);
+    if(thread->t_timer_index == 0) timer_arm();
+    return 0;
+}
+
+static void timer_remove(dccthread_t* thread) {
+    int i = thread->t_timer_index;
+    if(i < 0) return;
+    thread->t_timer_index = -1;
+
+    // The last one takes its place, the timer may fire early meanwhile
+    dccthread_t* last = scheduler.timers[--scheduler.n_timers];
+    if(last == thread) return;
+    scheduler.timers[i] = last;
+    last->t_timer_index = i;
+    timer_sift(i);
+}
+
+static void timer_sift(int i) {
+    dccthread_t** heap = scheduler.timers;
+    dccthread_t* t = heap[i];
+
+    // Up while earlier than the parent
+    while(i > 0) {
+        int parent = (i - 1) / 2;
+        if(timespec_cmp(heap[parent]->t_timer_at, t->t_timer_at) <= 0) break;
+        heap[i] = heap[parent];
+        heap[i]->t_timer_index = i;
+        i = parent;
+    }
+    // Down while later than a child
+    while(2 * i + 1 < scheduler.n_timers) {
+        int child = 2 * i + 1;
+        if(child + 1 < scheduler.n_timers
+           && timespec_cmp(heap[child + 1]->t_timer_at,
+                           heap[child]->t_timer_at)
+                  < 0)
+            child++;
+        if(timespec_cmp(t->t_timer_at, heap[child]->t_timer_at) <= 0) break;
+        heap[i] = heap[child];
+        heap[i]->t_timer_index = i;
+        i = child;
+    }
+    heap[i] = t;
+    t->t_timer_index = i;
+}
+
+static int threads_same(const void* e1, const void* e2, void* userdata) {
+    return e1 != e2;
+}
+
+static int timer_expire(struct timespec now, int precise) {
+    int woken = 0;
+    while(scheduler.n_timers) {
+        dccthread_t* t = scheduler.timers[0];
+        if(timespec_cmp(t->t_timer_at, now) > 0) break;
+        // Precise wakes jump the queue and throttled threads leave a list that
+        // frees its node, which only the precise path does
+        if((t->t_precise || t->state == THROTTLED) && !precise) break;
+        timer_remove(t);
+
+        // Leave whatever the thread was blocked on
+        if(t->state == WAITING) {
+            if(t->t_wait_target->t_waiting == t)
+                t->t_wait_target->t_waiting = NULL;
+            t->t_wait_target = NULL;
+            scheduler.n_waiting--;
+        }
+        else if(t->state == PARKED_ON) {
+            park_unlink(t);
+        }
+        else if(t->state == THROTTLED) {
+            dlist_find_remove(
+                scheduler.throttled_list, t, threads_same, NULL);
+            atomic_fetch_sub(&mem_accounting.throttled, 1);
+        }
+        t->t_timed_out = t->state != SLEEPING;
+        thread_set_state(t, RUNNABLE);
+        woken = 1;
+
+        if(t->t_precise) {
+            t->t_precise = 0;
+            t->t_precise_woken = 1;
+            dlist_unlink(scheduler.threads_list, &t->t_node);
+            dlist_link_left(scheduler.threads_list, &t->t_node);
+        }
+    }
+    return woken;
+}
+
+static void timer_arm(void) {
+    // Virtual time never needs a timer
+    if(scheduler.flags & DCCTHREAD_VIRTUAL_TIME) return;
+
+    struct timespec next = {0, 0};
+    if(scheduler.n_timers) next = scheduler.timers[0]->t_timer_at;
+    if(timespec_cmp(next, scheduler.precise_next) == 0) return;
+    struct itimerspec time;
+    time.it_value = next;
+    time.it_interval.tv_sec = 0;
+    time.it_interval.tv_nsec = 0;
+    scheduler.precise_next = next;
+    timer_settime(scheduler.precise_timer_id, TIMER_ABSTIME, &time, NULL);
+}
+
+static void park_unlink(dccthread_t* thread) {
+    struct park_bucket* bucket = park_bucket(thread->t_park_addr);
+    dccthread_t* prev = NULL;
+    for(dccthread_t* t = bucket->head; t != thread; t = t->t_park_next)
+        prev = t;
+
+    if(prev)
+        prev->t_park_next = thread->t_park_next;
+    else
+        bucket->head = thread->t_park_next;
+    if(bucket->tail == thread) bucket->tail = prev;
+    thread->t_park_addr = NULL;
+    thread->t_park_next = NULL;
+}
+
+static int sleep_until(struct timespec deadline) {
+    dccthread_t* self = scheduler.current_thread;
+    self->t_deadline = deadline;
+
+    // Virtual time has no jitter to bound
+    if(scheduler.flags & DCCTHREAD_VIRTUAL_TIME)
+        return block_until(SLEEPING, &deadline) == -1 ? -1 : 0;
+
+    // Long waits are parked until the deadline is within the threshold
+    struct timespec left = timespec_sub(deadline, dccthread_now());
+    if(timespec_cmp(left, scheduler.precise_threshold) > 0) {
+        struct timespec wake =
+            timespec_sub(deadline, scheduler.precise_threshold);
+        self->t_precise = 1;
+        if(block_until(SLEEPING, &wake) == -1) {
+            self->t_precise = 0;
+            return -1;
+        }
+    }
+    // Spin the remaining time still inside the critical section, so that the
+    // pre-emption can't delay the wake up by a whole round
+    spin_until(deadline);
+    // A tick taken meanwhile would send this thread straight to the end of the
+    // list, so drop it and start a fresh quantum
+    scheduler.preempt_pending = 0;
+    timer_settime(scheduler.timer_id, 0, &scheduler.timer_interval, NULL);
+    return 0;
+}
+
+static void spin_until(struct timespec deadline) {
+    while(timespec_cmp(dccthread_now(), deadline) < 0)
+        ;
+}
+
+static void thread_free(dccthread_t* thread) {
+    struct thread_batch* batch = thread->t_batch;
+    if(!batch || !batch->stacks) stack_free(thread->t_sched, thread->t_stack);
+    if(!batch) {
+        free(thread);
+        mem_release(sizeof(dccthread_t) + THREAD_STACK_SIZE, 1);
+        return;
+    }
+
+    // The memory shared by the batch stays accounted until it is unmapped
+    mem_release(batch->stacks ? 0 : THREAD_STACK_SIZE, 1);
+    if(--batch->live) return;
+    size_t n = batch->n_threads;
+    size_t bytes = n * sizeof(dccthread_t);
+    if(batch->stacks) {
+        munmap(batch->stacks, n * THREAD_STACK_SIZE);
+        bytes += n * THREAD_STACK_SIZE;
+    }
+    free(batch->threads);
+    free(batch);
+    mem_release(bytes, 0);
+}
+
+static char* stack_alloc(scheduler_t* sched) {
+    if(!(sched->flags & DCCTHREAD_STACK_ARENA))
+        return (char*)malloc(THREAD_STACK_SIZE * sizeof(char));
+
+    // Threads may also be created from other OS threads
+    pthread_mutex_lock(&stack_arena.lock);
+    char* slot;
+    if(stack_arena.free_head) {
+        char* stack = stack_arena.free_head;
+        stack_arena.free_head = *(char**)stack;
+        slot = stack - ARENA_GAP_SIZE;
+    }
+    else {
+        if(stack_arena.next + ARENA_SLOT_SIZE > stack_arena.end) {
+            char* region = arena_region();
+            if(!region) {
+                pthread_mutex_unlock(&stack_arena.lock);
+                return NULL;
             }
+            stack_arena.next = region;
+            stack_arena.end = region + ARENA_REGION_SIZE;
+        }
+        slot = stack_arena.next;
+        stack_arena.next += ARENA_SLOT_SIZE;
+    }
+    pthread_mutex_unlock(&stack_arena.lock);
 
-            // Removes node from the list
-            dlist_remove_from_node(scheduler.threads_list, cur);
-            // Removes this thread
-            free(scheduler.current_thread);
-            scheduler.current_thread = NULL;
+    // Stacks grow down, so an overflow runs over the top of the gap first
+    u_int64_t* canary =
+        (u_int64_t*)(slot + ARENA_GAP_SIZE) - ARENA_CANARY_WORDS;
+    for(int i = 0; i < ARENA_CANARY_WORDS; i++) canary[i] = ARENA_CANARY;
 
-            setcontext(&scheduler.ctx);
-            // Unblock timer signal but unnecessary command
-            sigprocmask(SIG_UNBLOCK, &scheduler.signals_set, NULL);
-            return;
+    return slot + ARENA_GAP_SIZE;
+}
+
+static void stack_free(scheduler_t* sched, char* stack) {
+    if(!(sched->flags & DCCTHREAD_STACK_ARENA)) {
+        free(stack);
+        return;
+    }
+
+    u_int64_t* canary = (u_int64_t*)stack - ARENA_CANARY_WORDS;
+    for(int i = 0; i < ARENA_CANARY_WORDS; i++) {
+        if(canary[i] != ARENA_CANARY) {
+            fprintf(stderr, "Thread stack overflow detected\n");
+            abort();
         }
-        //
-        cur = cur->next;
     }
-    // Unreachable code
-    puts(
-        "Unreachable piece of code and unexpected error. Look at "
-        "dccthread_exit source code.");
-    exit(EXIT_FAILURE);
+
+    pthread_mutex_lock(&stack_arena.lock);
+    *(char**)stack = stack_arena.free_head;
+    stack_arena.free_head = stack;
+    pthread_mutex_unlock(&stack_arena.lock);
 }
 
-void dccthread_wait(dccthread_t* tid) {
-    sigprocmask(SIG_BLOCK, &scheduler.signals_set, NULL);
+static char* arena_region(void) {
+    // Reserved huge pages first
+    void* region = mmap(NULL,
+                        ARENA_REGION_SIZE,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                        -1,
+                        0);
+    if(region != MAP_FAILED) return region;
 
-    // Search for the thread to be awaited
-    struct dnode* cur = scheduler.threads_list->head;
-    while(cur) {
-        dccthread_t* t = cur->data;
-        // If it's the thread to be awaited
-        if(t == tid) {
-            scheduler.current_thread->state = WAITING;
-            t->t_waiting = scheduler.current_thread;
-            scheduler.n_waiting++;
+    // Otherwise transparent ones, which need the region to be aligned
+    char* raw = mmap(NULL,
+                     2 * ARENA_REGION_SIZE,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1,
+                     0);
+    if(raw == MAP_FAILED) return NULL;
+    char* aligned = (char*)(((uintptr_t)raw + ARENA_REGION_SIZE - 1)
+                            & ~(uintptr_t)(ARENA_REGION_SIZE - 1));
+    if(aligned > raw) munmap(raw, aligned - raw);
+    munmap(aligned + ARENA_REGION_SIZE,
+           raw + 2 * ARENA_REGION_SIZE - (aligned + ARENA_REGION_SIZE));
+    madvise(aligned, ARENA_REGION_SIZE, MADV_HUGEPAGE);
 
-            swapcontext(&scheduler.current_thread->t_context, &scheduler.ctx);
-            // Unblock timer signal
-            sigprocmask(SIG_UNBLOCK, &scheduler.signals_set, NULL);
-            return;
+    return aligned;
+}
+
+static int mem_reserve(size_t bytes, int threads) {
+    // Reserve first and roll back, so that concurrent creations from other OS
+    // threads never overshoot the limits
+    size_t total = atomic_fetch_add(&mem_accounting.bytes, bytes) + bytes;
+    int n_threads =
+        atomic_fetch_add(&mem_accounting.threads, threads) + threads;
+    if((mem_accounting.max_bytes && total > mem_accounting.max_bytes)
+       || (mem_accounting.max_threads
+           && n_threads > mem_accounting.max_threads)) {
+        atomic_fetch_sub(&mem_accounting.bytes, bytes);
+        atomic_fetch_sub(&mem_accounting.threads, threads);
+        return 0;
+    }
+    return 1;
+}
+
+static void mem_release(size_t bytes, int threads) {
+    atomic_fetch_sub(&mem_accounting.bytes, bytes);
+    atomic_fetch_sub(&mem_accounting.threads, threads);
+    atomic_fetch_add(&mem_accounting.releases, 1);
+    // Threads throttled on any scheduler may fit now
+    if(atomic_load(&mem_accounting.throttled)) throttled_notify();
+}
+
+static void sched_registry_init(void) {
+    pthread_key_create(&sched_registry.key, sched_unregister);
+}
+
+static void sched_register(void) {
+    pthread_once(&sched_registry.once, sched_registry_init);
+    // Only a non NULL value makes the destructor run
+    pthread_setspecific(sched_registry.key, &scheduler);
+    pthread_mutex_lock(&sched_registry.lock);
+    scheduler.next_registered = sched_registry.head;
+    sched_registry.head = &scheduler;
+    pthread_mutex_unlock(&sched_registry.lock);
+}
+
+static void sched_unregister(void* sched) {
+    // A dump signal no longer has a scheduler to go to
+    scheduler_t* expected = sched;
+    atomic_compare_exchange_strong(&dump_signal.sched, &expected, NULL);
+    pthread_mutex_lock(&sched_registry.lock);
+    scheduler_t** cur = &sched_registry.head;
+    while(*cur && *cur != sched) cur = &(*cur)->next_registered;
+    if(*cur) *cur = (*cur)->next_registered;
+    pthread_mutex_unlock(&sched_registry.lock);
+}
+
+static void throttled_notify(void) {
+    pthread_mutex_lock(&sched_registry.lock);
+    for(scheduler_t* s = sched_registry.head; s; s = s->next_registered) {
+        atomic_store(&s->limit_freed, 1);
+        // The calling scheduler gets to it on its next pass anyway
+        if(s != &scheduler) ring_doorbell(s);
+    }
+    pthread_mutex_unlock(&sched_registry.lock);
+}
+
+static void thread_start(void) {
+    // Threads are first dispatched from inside the critical section
+    critical_exit();
+    dccthread_t* self = scheduler.current_thread;
+    self->t_func(self->t_param);
+    dccthread_exit();
+}
+
+static void gen_start(void) {
+    dccthread_gen_t* gen = scheduler.current_thread->t_gen;
+    gen->func(gen->param);
+
+    gen->done = 1;
+    gen->value = NULL;
+    setcontext(&gen->caller);
+}
+
+static void inbox_push(dccthread_t* thread) {
+    // Called from any OS thread, so the scheduler is the thread's one
+    scheduler_t* sched = thread->t_sched;
+    dccthread_t* head =
+        atomic_load_explicit(&sched->inbox_head, memory_order_relaxed);
+    do {
+        thread->t_inbox_next = head;
+    } while(!atomic_compare_exchange_weak_explicit(&sched->inbox_head,
+                                                   &head,
+                                                   thread,
+                                                   memory_order_release,
+                                                   memory_order_relaxed));
+    // Only the first push of a batch needs to wake the scheduler
+    if(!head) ring_doorbell(sched);
+}
+
+static void inbox_drain(void) {
+    dccthread_t* batch =
+        atomic_exchange_explicit(&scheduler.inbox_head, NULL,
+                                 memory_order_acquire);
+    // The inbox is a LIFO, reverse it to apply the requests in order
+    dccthread_t* ordered = NULL;
+    while(batch) {
+        dccthread_t* next = batch->t_inbox_next;
+        batch->t_inbox_next = ordered;
+        ordered = batch;
+        batch = next;
+    }
+
+    while(ordered) {
+        dccthread_t* t = ordered;
+        ordered = t->t_inbox_next;
+        // Allow the thread to be pushed again from now on
+        atomic_store_explicit(&t->t_inbox_queued, 0, memory_order_relaxed);
+
+        if(t->t_remote_spawn) {
+            t->t_remote_spawn = 0;
+            dlist_link_right(scheduler.threads_list, &t->t_node);
+            scheduler.n_states[RUNNABLE]++;
         }
-        //
-        cur = cur->next;
+        else if(t->state == PARKED) {
+            timer_remove(t);
+            thread_set_state(t, RUNNABLE);
+        }
+        else {
+            t->t_wake_pending = 1;
+        }
+    }
+
+    // Memory was released somewhere in the process: let the oldest throttled
+    // thread try again
+    if(atomic_exchange_explicit(&scheduler.limit_freed, 0, memory_order_relaxed)
+       && !dlist_empty(scheduler.throttled_list)) {
+        dccthread_t* t = dlist_pop_left(scheduler.throttled_list);
+        atomic_fetch_sub(&mem_accounting.throttled, 1);
+        timer_remove(t);
+        thread_set_state(t, RUNNABLE);
+    }
+
+    // Finished offloads, their order doesn't matter
+    struct offload_job* job = atomic_exchange_explicit(
+        &scheduler.offload_done_head, NULL, memory_order_acquire);
+    while(job) {
+        struct offload_job* next = job->next;
+        thread_set_state(job->caller, RUNNABLE);
+        scheduler.n_offloaded--;
+        job = next;
     }
-    // Unblock timer signal since the thread id doesn't exist
-    sigprocmask(SIG_UNBLOCK, &scheduler.signals_set, NULL);
 }
 
-void sleep_timer_handler(int signo, siginfo_t* wrapped_info, void* _) {
-    dccthread_t* thread = wrapped_info->si_value.sival_ptr;
-    // Unwrap the info and turn the thread executable again
-    thread->state = RUNNABLE;
+static void run_key_destructors(void) {
+    dccthread_t* self = scheduler.current_thread;
+    unsigned int n_keys = key_count();
+
+    // A destructor may set values again, so retry a few times as pthreads do
+    for(int round = 0; round < 4; round++) {
+        int called = 0;
+        for(dccthread_key_t key = 0; key < n_keys; key++) {
+            void (*destructor)(void*) = key_registry.destructors[key];
+            void* value = dccthread_getspecific(key);
+            if(!destructor || !value) continue;
+
+            dccthread_setspecific(key, NULL);
+            destructor(value);
+            called = 1;
+        }
+        if(!called) break;
+    }
+
+    free(self->t_specific_overflow);
+    self->t_specific_overflow = NULL;
+    self->t_specific_overflow_size = 0;
 }
 
-void dccthread_sleep(struct timespec ts) {
-    sigprocmask(SIG_BLOCK, &scheduler.signals_set, NULL);
+static unsigned int key_count(void) {
+    // A failed create may have left the counter past the limit for a moment
+    unsigned int n_keys = atomic_load(&key_registry.n_keys);
+    return n_keys < DCCTHREAD_KEYS_MAX ? n_keys : DCCTHREAD_KEYS_MAX;
+}
 
-    // Blocks the thread from execution
-    scheduler.current_thread->state = SLEEPING;
+static void offload_pool_start(void) {
+    // The OS threads inherit the signal mask, make sure none of the scheduler
+    // signals is ever handled by them
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
 
-    struct sigevent sev;
-    timer_t timer_id;
-    // Define timer signal event
-    sev.sigev_notify = SIGEV_SIGNAL;
-    sev.sigev_signo = SLEEP_SIGNAL;
-    sev.sigev_value.sival_ptr =
-        scheduler
-            .current_thread;  // Allow the timer handler to receive your thread
-                              // point related to the correct timer event
-    // Defines action on signal detection
-    struct sigaction sa;
-    sa.sa_sigaction = sleep_timer_handler;
-    sa.sa_flags = SA_SIGINFO;  // Allow the user to pass more infos to the timer
-    sa.sa_mask = scheduler.signals_set;  // Make sure all the signals are
-                                         // blocked inside the handler
-    sigaction(SLEEP_SIGNAL, &sa, NULL);
-    // Create timer
-    if(timer_create(CLOCK_REALTIME, &sev, &timer_id) == -1) {
-        printf("Error while creating timer\n");
-        exit(EXIT_FAILURE);
+    for(int i = 0; i < offload_pool.n_threads; i++) {
+        pthread_t pthread;
+        if(pthread_create(&pthread, NULL, offload_worker, NULL) != 0) {
+            printf("Error while creating offload thread\n");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(pthread);
     }
 
-    // Define timer interval to the desired one
-    struct itimerspec time;
-    time.it_value = ts;
-    time.it_interval.tv_nsec = 0;
-    time.it_interval.tv_sec = 0;
-    // Start timer
-    timer_settime(timer_id, 0, &time, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
 
-    // Swap back to the scheduler context
-    swapcontext(&scheduler.current_thread->t_context, &scheduler.ctx);
+static void* offload_worker(void* _) {
+    while(1) {
+        pthread_mutex_lock(&offload_pool.lock);
+        while(!offload_pool.head)
+            pthread_cond_wait(&offload_pool.cond, &offload_pool.lock);
+        struct offload_job* job = offload_pool.head;
+        offload_pool.head = job->next;
+        if(!offload_pool.head) offload_pool.tail = NULL;
+        pthread_mutex_unlock(&offload_pool.lock);
 
-    sigprocmask(SIG_UNBLOCK, &scheduler.signals_set, NULL);
+        job->result = job->func(job->arg);
+
+        // Hand the job back to the scheduler, which owns it from now on
+        scheduler_t* sched = job->caller->t_sched;
+        struct offload_job* head = atomic_load_explicit(
+            &sched->offload_done_head, memory_order_relaxed);
+        do {
+            job->next = head;
+        } while(!atomic_compare_exchange_weak_explicit(
+            &sched->offload_done_head,
+            &head,
+            job,
+            memory_order_release,
+            memory_order_relaxed));
+        if(!head) ring_doorbell(sched);
+    }
+
+    return NULL;
 }
 
-dccthread_t* dccthread_self(void) { return scheduler.current_thread; }
+static void wait_doorbell(void) {
+    struct pollfd pfd;
+    pfd.fd = scheduler.doorbell_fd;
+    pfd.events = POLLIN;
 
-const char* dccthread_name(dccthread_t* tid) { return tid->t_name; }
+    // Don't sleep past the next timeout
+    struct timespec timeout;
+    struct timespec* timeout_ptr = NULL;
+    if(scheduler.n_timers) {
+        timeout =
+            timespec_sub(scheduler.timers[0]->t_timer_at, dccthread_now());
+        timeout_ptr = &timeout;
+    }
+    // Nor past the next stack to reclaim
+    if(scheduler.reclaim_pending) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        struct timespec left = timespec_sub(scheduler.reclaim_next, now);
+        if(!timeout_ptr || timespec_cmp(left, timeout) < 0) timeout = left;
+        timeout_ptr = &timeout;
+    }
 
-int dccthread_nwaiting() { return scheduler.n_waiting; }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ppoll(&pfd, 1, timeout_ptr, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    scheduler.idle_ns += timespec_ns(timespec_sub(end, start));
+    // Reset the doorbell
+    eventfd_t value;
+    eventfd_read(scheduler.doorbell_fd, &value);
+    if(scheduler.stats) stats_publish();
+}
 
-int dccthread_nexited() { return scheduler.n_exited; }
+static void ring_doorbell(scheduler_t* sched) {
+    eventfd_write(sched->doorbell_fd, 1);
+}
 
-void configure_timer() {
-    // Initializes signs blockers for timers
-    sigemptyset(&scheduler.signals_set);
-    sigaddset(&scheduler.signals_set, PRE_EMPTION_SIG);
-    // Blocks timer for scheduler thread
-    sigprocmask(SIG_BLOCK, &scheduler.signals_set, NULL);
-    scheduler.ctx.uc_sigmask = scheduler.signals_set;
-    // Define timer signal event
-    scheduler.sev.sigev_value.sival_ptr = &scheduler.timer_id;
-    scheduler.sev.sigev_notify = SIGEV_SIGNAL;
-    scheduler.sev.sigev_signo = PRE_EMPTION_SIG;
-    // Defines action on signal detection
-    scheduler.sa.sa_handler = timer_handler;
-    scheduler.sa.sa_flags = 0;
-    sigaction(PRE_EMPTION_SIG, &scheduler.sa, NULL);
-    // Create timer
-    if(timer_create(
-           CLOCK_PROCESS_CPUTIME_ID, &scheduler.sev, &scheduler.timer_id)
-       == -1) {
-        printf("Error while creating timer\n");
-        exit(EXIT_FAILURE);
+static void reclaim_stacks(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(timespec_cmp(now, scheduler.reclaim_next) < 0) return;
+
+    long page = sysconf(_SC_PAGESIZE);
+    scheduler.reclaim_pending = 0;
+    for(struct dnode* cur = scheduler.threads_list->head; cur;
+        cur = cur->next) {
+        dccthread_t* t = cur->data;
+        if(t->state < WAITING || t->t_reclaimed) continue;
+
+        struct timespec due =
+            timespec_add(t->t_state_since, scheduler.reclaim_threshold);
+        if(timespec_cmp(now, due) < 0) {
+            if(!scheduler.reclaim_pending
+               || timespec_cmp(due, scheduler.reclaim_next) < 0)
+                scheduler.reclaim_next = due;
+            scheduler.reclaim_pending = 1;
+            continue;
+        }
+        t->t_reclaimed = 1;
+
+        // Everything below the stack pointer is dead, except for the red zone
+        uintptr_t pc, sp, fp;
+        if(!context_regs(&t->t_context.uc_mcontext, &pc, &sp, &fp)) continue;
+        uintptr_t low = ((uintptr_t)t->t_stack + page - 1) & ~(page - 1);
+        uintptr_t high = (sp - 128) & ~(page - 1);
+        // Blocked inside a generator, on another stack
+        if(sp <= (uintptr_t)t->t_stack
+           || sp > (uintptr_t)t->t_stack + THREAD_STACK_SIZE || high <= low)
+            continue;
+
+        // Only the resident pages count as reclaimed
+        unsigned char resident[THREAD_STACK_SIZE / 4096 + 1];
+        size_t n_pages = (high - low) / page;
+        if(mincore((void*)low, high - low, resident) == -1) continue;
+        size_t bytes = 0;
+        for(size_t i = 0; i < n_pages; i++)
+            if(resident[i] & 1) bytes += page;
+        if(!bytes) continue;
+
+        if(madvise((void*)low, high - low, MADV_DONTNEED) == 0)
+            atomic_fetch_add(&mem_accounting.reclaimed, bytes);
     }
+}
 
-    // Define timer interval of 10ms
-    scheduler.timer_interval.it_interval.tv_nsec = 10000000;
-    scheduler.timer_interval.it_interval.tv_sec = 0;
-    scheduler.timer_interval.it_value = scheduler.timer_interval.it_interval;
-    // Start timer
-    timer_settime(scheduler.timer_id, 0, &scheduler.timer_interval, NULL);
+static int context_regs(mcontext_t* mc,
+                        uintptr_t* pc,
+                        uintptr_t* sp,
+                        uintptr_t* fp) {
+#if defined(__x86_64__)
+    *pc = mc->gregs[REG_RIP];
+    *sp = mc->gregs[REG_RSP];
+    *fp = mc->gregs[REG_RBP];
+    return 1;
+#elif defined(__aarch64__)
+    *pc = mc->pc;
+    *sp = mc->sp;
+    *fp = mc->regs[29];
+    return 1;
+#else
+    return 0;
+#endif
 }
 
-void timer_handler(int signal) {
-    // Stops the current thread
-    dccthread_yield();
+static int frame_walk(uintptr_t fp,
+                      uintptr_t sp,
+                      uintptr_t high,
+                      void** pcs,
+                      int max) {
+    // Each frame holds the caller frame pointer and the return address, and
+    // callers are always higher up on the stack
+    int depth = 0;
+    while(depth < max && fp >= sp && fp + 2 * sizeof(uintptr_t) <= high
+          && !(fp & 7)) {
+        uintptr_t* frame = (uintptr_t*)fp;
+        if(!frame[1]) break;
+        pcs[depth++] = (void*)frame[1];
+        if(frame[0] <= fp) break;
+        fp = frame[0];
+    }
+    return depth;
+}
+
+static int advance_virtual_clock(void) {
+    // Nobody sleeping, nothing to advance to
+    if(!scheduler.n_timers) return 0;
+
+    // Jump to the earliest wake up and wake everyone due. Only the state
+    // changes, so ties keep the list order as in real time.
+    struct timespec earliest = scheduler.timers[0]->t_timer_at;
+    if(timespec_cmp(earliest, scheduler.virtual_now) > 0)
+        scheduler.virtual_now = earliest;
+    return timer_expire(scheduler.virtual_now, 1);
+}
+
+static struct timespec timespec_add(struct timespec a, struct timespec b) {
+    struct timespec r;
+    r.tv_sec = a.tv_sec + b.tv_sec;
+    r.tv_nsec = a.tv_nsec + b.tv_nsec;
+    if(r.tv_nsec >= 1000000000) {
+        r.tv_sec++;
+        r.tv_nsec -= 1000000000;
+    }
+    return r;
+}
+
+static struct timespec timespec_sub(struct timespec a, struct timespec b) {
+    struct timespec r = {0, 0};
+    if(timespec_cmp(a, b) <= 0) return r;
+    r.tv_sec = a.tv_sec - b.tv_sec;
+    r.tv_nsec = a.tv_nsec - b.tv_nsec;
+    if(r.tv_nsec < 0) {
+        r.tv_sec--;
+        r.tv_nsec += 1000000000;
+    }
+    return r;
+}
+
+static struct park_bucket* park_bucket(volatile int* addr) {
+    // Fibonacci hashing, the low bits of an int address carry no information
+    u_int64_t hash = ((uintptr_t)addr >> 2) * 0x9E3779B97F4A7C15ull;
+    return &scheduler.park_table[hash >> 56 & (PARK_BUCKETS - 1)];
+}
+
+static u_int64_t timespec_ns(struct timespec ts) {
+    return (u_int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int timespec_cmp(struct timespec a, struct timespec b) {
+    if(a.tv_sec != b.tv_sec) return a.tv_sec < b.tv_sec ? -1 : 1;
+    if(a.tv_nsec != b.tv_nsec) return a.tv_nsec < b.tv_nsec ? -1 : 1;
+    return 0;
 }
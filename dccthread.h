@@ -11,9 +11,96 @@
 
 typedef struct dccthread dccthread_t;
 typedef struct scheduler scheduler_t;
+typedef unsigned int dccthread_key_t;
+typedef struct dccthread_group dccthread_group_t;
+typedef struct dccthread_gen dccthread_gen_t;
 
 #define DCCTHREAD_MAX_NAME_SIZE 256
+// No signal handler runs on the thread stacks on x86_64, so they only need to
+// fit the thread code and may be built as small as 8 KiB
+#ifndef THREAD_STACK_SIZE
 #define THREAD_STACK_SIZE (1 << 16)
+#endif
+// Thread specific values kept inside the thread itself, the others go to an
+// overflow table
+#define DCCTHREAD_KEYS_INLINE 8
+#define DCCTHREAD_KEYS_MAX 1024
+// Weight of the group threads belong to when none is given
+#define DCCTHREAD_DEFAULT_WEIGHT 1024
+
+// What `dccthread_create` does when a memory or thread limit is hit
+#define DCCTHREAD_LIMIT_FAIL 0
+#define DCCTHREAD_LIMIT_BLOCK 1
+
+/**
+ * @brief Memory committed to thread descriptors and stacks, and the limits
+ * enforced on it (0 means unlimited). <reclaimed> is the total of resident
+ * stack bytes given back to the OS from blocked threads.
+ *
+ */
+struct dccthread_mem_stats {
+    size_t bytes;
+    size_t max_bytes;
+    int threads;
+    int max_threads;
+    size_t reclaimed;
+};
+
+// Identifies the segment written by `dccthread_stats_export`, the version is
+// bumped whenever the layout of `struct dccthread_shm_stats` changes
+#define DCCTHREAD_STATS_MAGIC 0x44434353u
+#define DCCTHREAD_STATS_VERSION 1
+
+/**
+ * @brief Scheduler counters published in shared memory by
+ * `dccthread_stats_export`. The scheduler is the only writer: <seq> is odd
+ * while it updates the other fields, so readers must go through
+ * `dccthread_stats_read`. The thread counts are by state, <exited> counts the
+ * threads that exited without being waited for and <idle_ns> the time the
+ * scheduler slept with no thread to run.
+ *
+ */
+struct dccthread_shm_stats {
+    u_int32_t magic;
+    u_int32_t version;
+    volatile u_int64_t seq;
+    u_int64_t pid;
+    u_int64_t os_tid;
+    u_int64_t live;
+    u_int64_t running;
+    u_int64_t runnable;
+    u_int64_t waiting;
+    u_int64_t sleeping;
+    u_int64_t parked;
+    u_int64_t offloaded;
+    u_int64_t throttled;
+    u_int64_t exited;
+    u_int64_t switches;
+    u_int64_t preemptions;
+    u_int64_t idle_ns;
+};
+
+/**
+ * @brief Flags accepted by `dccthread_init_flags`.
+ *
+ * DCCTHREAD_VIRTUAL_TIME: sleeps are measured against a virtual clock that
+ * starts at zero and only moves when no thread is runnable, jumping straight to
+ * the earliest sleep deadline or timeout.
+ *
+ * DCCTHREAD_COOPERATIVE: the pre-emption timer doesn't switch threads from the
+ * signal handler, it only asks the running thread to yield at its next
+ * `dccthread_checkpoint`.
+ *
+ * DCCTHREAD_STACK_ARENA: opt-in, off by default. Thread stacks are carved out
+ * of 2 MiB huge page regions (transparent huge pages when none are reserved),
+ * with a gap between them, instead of being malloc'd. Every region touched is
+ * backed in full, so the resident memory grows about tenfold for a switch
+ * rate that is only marginally higher; only worth it when TLB misses on
+ * switches dominate and memory is plentiful.
+ */
+#define DCCTHREAD_VIRTUAL_TIME (1 << 0)
+#define DCCTHREAD_COOPERATIVE (1 << 1)
+#define DCCTHREAD_STACK_ARENA (1 << 2)
 
 /**
  * @brief Function responsible for simulating a thread scheduler.
@@ -23,22 +110,240 @@ typedef struct scheduler scheduler_t;
  */
 void dccthread_init(void (*func)(int), int param) __attribute__((noreturn));
 
+/**
+ * @brief Same as `dccthread_init`, but allows some scheduler modes to be
+ * enabled.
+ *
+ * @param func The function for the main thread to be spawned.
+ * @param param Parameter to be passed to <func>
+ * @param flags Bitwise OR of DCCTHREAD_* flags.
+ */
+void dccthread_init_flags(void (*func)(int), int param, int flags)
+    __attribute__((noreturn));
+
+/**
+ * @brief Sets the scheduler up without taking over the calling OS thread, for
+ * hosts that drive it from their own loop with `dccthread_run_once` or hand it
+ * over with `dccthread_sched_run`. Threads are then created with
+ * `dccthread_create`.
+ *
+ * Every OS thread has its own scheduler, with its own threads, timers and
+ * signals, so several OS threads may each create and run one at once. Threads
+ * never move between schedulers, and the waits, parks and groups only work
+ * within one of them.
+ *
+ * @param flags Bitwise OR of DCCTHREAD_* flags.
+ * @return int 0 on success, -1 on error.
+ */
+int dccthread_sched_create(int flags);
+
+/**
+ * @brief Runs the scheduler of the calling OS thread until all its threads
+ * exited, then returns. New threads may be created and run again afterwards.
+ *
+ * @return int 0.
+ */
+int dccthread_sched_run(void);
+
+/**
+ * @brief Pins the calling OS thread, and so its scheduler, to one CPU.
+ *
+ * @param cpu The CPU number.
+ * @return int 0 on success, -1 on error.
+ */
+int dccthread_sched_affinity(int cpu);
+
+/**
+ * @brief Function that returns the scheduler of the calling OS thread, to be
+ * handed to `dccthread_create_on` by the other ones.
+ *
+ * @return scheduler_t* the scheduler, NULL if none was created.
+ */
+scheduler_t* dccthread_sched_self(void);
+
+/**
+ * @brief Dispatches runnable threads until none is left, <max_threads> were
+ * dispatched or <budget> expired, and returns to the host. The budget is only
+ * checked between dispatches, so it may be overrun by one time slice. On
+ * virtual time the clock moves on whenever nobody is runnable.
+ *
+ * @param max_threads Maximum number of dispatches, 0 for no limit.
+ * @param budget Maximum time spent, zero for no limit.
+ * @return int number of dispatches.
+ */
+int dccthread_run_once(int max_threads, struct timespec budget);
+
+/**
+ * @brief Function that returns a file descriptor that polls readable when
+ * `dccthread_run_once` has work to do: threads left runnable, sleepers to wake
+ * up or requests from other OS threads.
+ *
+ * @return int the file descriptor, owned by the scheduler.
+ */
+int dccthread_sched_fd(void);
+
+/**
+ * @brief Function that returns the number of threads that haven't exited yet.
+ *
+ * @return int number of live threads.
+ */
+int dccthread_nthreads(void);
+
 /**
  * @brief Creates a dcc thread.
  *
  * @param name The name of the thread.
  * @param func The callback function that the thread is going to execute.
  * @param param The parameter to be passed into the callback function.
- * @return dccthread_t*
+ * @return dccthread_t* The new thread, or NULL if it couldn't be allocated or a
+ * limit set by `dccthread_set_limits` was hit with the DCCTHREAD_LIMIT_FAIL
+ * policy.
  */
 dccthread_t* dccthread_create(const char* name, void (*func)(int), int param);
 
+/**
+ * @brief Creates <n> threads at once, all running <func>. The descriptors and
+ * the stacks are allocated in one block each and the threads are queued
+ * together, which is much cheaper than <n> calls to `dccthread_create`. The
+ * memory of the batch is released when its last thread exits, and counts
+ * against the memory limit set by `dccthread_set_limits` until then.
+ *
+ * @param n The number of threads.
+ * @param func The callback function that the threads are going to execute.
+ * @param params The parameter of each thread, or NULL to pass each thread its
+ * index.
+ * @param names The name of each thread, or NULL to name them by their index.
+ * @param out Receives the <n> new threads, may be NULL.
+ * @return int 0 on success, -1 if the threads couldn't be allocated or a limit
+ * set by `dccthread_set_limits` would be hit. Either all the threads are
+ * created or none is, and it never blocks on the limits.
+ */
+int dccthread_create_many(int n,
+                          void (*func)(int),
+                          const int* params,
+                          const char* const* names,
+                          dccthread_t** out);
+
+/**
+ * @brief Creates a scheduling group. The CPU time is split between the groups
+ * with runnable threads in proportion to their weights, and round robin is used
+ * inside each group. Threads that aren't created on a group belong to their
+ * creator's group, or to the default group of weight DCCTHREAD_DEFAULT_WEIGHT.
+ *
+ * @param weight The group weight, must be greater than 0.
+ * @return dccthread_group_t* The new group, or NULL on error.
+ */
+dccthread_group_t* dccthread_sched_group_create(unsigned int weight);
+
+/**
+ * @brief Same as `dccthread_create`, but places the thread on <group>.
+ *
+ * @param group The group created by `dccthread_sched_group_create`.
+ * @param name The name of the thread.
+ * @param func The callback function that the thread is going to execute.
+ * @param param The parameter to be passed into the callback function.
+ * @return dccthread_t*
+ */
+dccthread_t* dccthread_create_in_group(dccthread_group_t* group,
+                                       const char* name,
+                                       void (*func)(int),
+                                       int param);
+
+/**
+ * @brief Same as `dccthread_create_in_group`, but under DCCTHREAD_LIMIT_BLOCK
+ * gives up after waiting <timeout> for a thread limit to clear.
+ *
+ * @param group The group created by `dccthread_sched_group_create`.
+ * @param name The name of the thread.
+ * @param func The callback function that the thread is going to execute.
+ * @param param The parameter to be passed into the callback function.
+ * @param timeout Maximum amount of time to wait.
+ * @return dccthread_t* The new thread, or NULL on error or timeout. errno is
+ * set to ENOMEM if the timeout couldn't be set up.
+ */
+dccthread_t* dccthread_create_in_group_timeout(dccthread_group_t* group,
+                                               const char* name,
+                                               void (*func)(int),
+                                               int param,
+                                               struct timespec timeout);
+
+/**
+ * @brief Puts a thread on the earliest deadline first class. Runnable threads
+ * of this class always run before the round robin ones, the one with the
+ * earliest absolute deadline first. Each job is released at the start of a
+ * period and must be finished, by calling `dccthread_deadline_done`, within
+ * <deadline> of it. A job that runs for longer than <budget> falls back to
+ * round robin until the next period.
+ *
+ * @param tid The thread.
+ * @param deadline Deadline of each job relative to its release. Zero takes the
+ * thread out of the class.
+ * @param period Time between job releases. Zero for a single job, released
+ * now, after which the thread goes back to round robin.
+ * @param budget Run time allowed per job. Zero for no budget.
+ * @return int 0 on success, -1 if the parameters are invalid.
+ */
+int dccthread_set_deadline(dccthread_t* tid,
+                           struct timespec deadline,
+                           struct timespec period,
+                           struct timespec budget);
+
+/**
+ * @brief Finishes the current job of an earliest deadline first thread,
+ * blocking it until the next period starts.
+ *
+ * @return int 0 on success, -1 with errno set to ENOMEM if the thread couldn't
+ * block, in which case the next job starts right away.
+ */
+int dccthread_deadline_done(void);
+
+/**
+ * @brief Function that returns how many jobs missed their deadline.
+ *
+ * @param tid The thread, or NULL for the total of all threads.
+ * @return int number of missed deadlines.
+ */
+int dccthread_deadline_misses(dccthread_t* tid);
+
 /**
  * @brief Function that makes a thread yield and comeback to the scheduler.
  *
  */
 void dccthread_yield(void);
 
+/**
+ * @brief Set by the pre-emption timer on DCCTHREAD_COOPERATIVE mode when the
+ * running thread has used up its quantum. One per OS thread, as the schedulers.
+ *
+ */
+extern __thread volatile sig_atomic_t dccthread_yield_requested;
+
+/**
+ * @brief Safe point for the DCCTHREAD_COOPERATIVE mode: yields if the quantum
+ * of the current thread is over. Long running loops should call it once per
+ * iteration. Code built with -finstrument-functions against a dccthread.c built
+ * with -DDCCTHREAD_INSTRUMENT gets one on every function entry.
+ *
+ */
+static inline void dccthread_checkpoint(void) {
+    if(__builtin_expect(dccthread_yield_requested, 0)) dccthread_yield();
+}
+
+/**
+ * @brief Keeps the current thread from being pre-empted until the matching
+ * `dccthread_preempt_enable`, without any system call. Calls nest. A tick
+ * taken meanwhile switches threads when the outermost call is undone; blocking
+ * calls still switch right away.
+ *
+ */
+void dccthread_preempt_disable(void);
+
+/**
+ * @brief Undoes a `dccthread_preempt_disable`.
+ *
+ */
+void dccthread_preempt_enable(void);
+
 /**
  * @brief Function that stops a thread execution flow and removes it from the
  * threads list
@@ -54,12 +359,212 @@ void dccthread_exit(void);
  */
 void dccthread_wait(dccthread_t* tid);
 
+/**
+ * @brief Same as `dccthread_wait`, but gives up after <timeout> on the
+ * scheduler clock. A waiter that gives up no longer holds the target, which may
+ * be waited for again.
+ *
+ * @param tid Pointer to the thread to be waited.
+ * @param timeout Maximum amount of time to wait.
+ * @return int 0 if the thread exited (or doesn't exist), -1 on timeout, or with
+ * errno set to ENOMEM if the timeout couldn't be set up.
+ */
+int dccthread_wait_timeout(dccthread_t* tid, struct timespec timeout);
+
 /**
  * @brief Function that stops the current thread for a given amount of time.
  *
  * @param ts Amount of time the thread will sleep.
+ * @return int 0 on success, -1 with errno set to ENOMEM if the wake up couldn't
+ * be set up, without sleeping.
+ */
+int dccthread_sleep(struct timespec ts);
+
+/**
+ * @brief Function that stops the current thread for a given amount of time with
+ * a bounded wake up jitter. The deadline is absolute on CLOCK_MONOTONIC: the
+ * thread is parked until it is within the precision threshold of the deadline,
+ * then it is dispatched ahead of the other runnable threads and spins for the
+ * remaining time. Waits shorter than the threshold just spin.
+ *
+ * @param ts Amount of time the thread will sleep.
+ * @return int 0 on success, -1 with errno set to ENOMEM if the wake up couldn't
+ * be set up, without sleeping.
+ */
+int dccthread_sleep_precise(struct timespec ts);
+
+/**
+ * @brief Function that sets how long before its deadline a precise sleeper is
+ * woken up to spin (see `dccthread_sleep_precise`). Defaults to 100us.
+ *
+ * @param threshold The spin threshold.
+ */
+void dccthread_set_precise_threshold(struct timespec threshold);
+
+/**
+ * @brief Function that parks the current thread until it is woken up by
+ * `dccthread_wake_remote`. If a wake up was already delivered since the last
+ * park, returns immediately.
+ *
+ */
+void dccthread_park(void);
+
+/**
+ * @brief Same as `dccthread_park`, but gives up after <timeout> on the
+ * scheduler clock.
+ *
+ * @param timeout Maximum amount of time to stay parked.
+ * @return int 0 if the thread was woken up, -1 on timeout, or with errno set to
+ * ENOMEM if the timeout couldn't be set up.
+ */
+int dccthread_park_timeout(struct timespec timeout);
+
+/**
+ * @brief Wakes up a parked thread. Safe to be called from any OS thread: the
+ * request is pushed into the scheduler inbox and applied on its next pass. The
+ * thread must not exit before the wake up is applied.
+ *
+ * @param tid The thread to be woken up.
+ */
+void dccthread_wake_remote(dccthread_t* tid);
+
+/**
+ * @brief Function that parks the current thread on <addr>, as long as it still
+ * holds <expected>, until `dccthread_unpark` is called on the same address.
+ * The check and the park happen atomically with respect to the other threads.
+ *
+ * @param addr The address to wait on.
+ * @param expected The value <addr> must hold for the thread to park.
+ * @return int 0 if the thread parked and was woken up, -1 if <addr> didn't
+ * hold <expected>.
+ */
+int dccthread_park_on(volatile int* addr, int expected);
+
+/**
+ * @brief Same as `dccthread_park_on`, but gives up after <timeout> on the
+ * scheduler clock, leaving the wait queue of <addr>.
+ *
+ * @param addr The address to wait on.
+ * @param expected The value <addr> must hold for the thread to park.
+ * @param timeout Maximum amount of time to stay parked.
+ * @return int 0 if the thread parked and was woken up, -1 if <addr> didn't
+ * hold <expected>, on timeout, or with errno set to ENOMEM if the timeout
+ * couldn't be set up.
+ */
+int dccthread_park_on_timeout(volatile int* addr,
+                              int expected,
+                              struct timespec timeout);
+
+/**
+ * @brief Function that wakes up threads parked on <addr>, in the order they
+ * parked.
+ *
+ * @param addr The address the threads wait on.
+ * @param n Maximum number of threads to wake up.
+ * @return int number of threads woken up.
+ */
+int dccthread_unpark(volatile int* addr, int n);
+
+/**
+ * @brief Same as `dccthread_create`, but safe to be called from any OS thread.
+ * The thread is added to the threads list of the first scheduler created in
+ * the process on its next pass.
+ *
+ * @param name The name of the thread.
+ * @param func The callback function that the thread is going to execute.
+ * @param param The parameter to be passed into the callback function.
+ * @return dccthread_t*
  */
-void dccthread_sleep(struct timespec ts);
+dccthread_t* dccthread_create_remote(const char* name,
+                                     void (*func)(int),
+                                     int param);
+
+/**
+ * @brief Same as `dccthread_create_remote`, but for the scheduler <sched>.
+ *
+ * @param sched The scheduler, from `dccthread_sched_self`.
+ * @param name The name of the thread.
+ * @param func The callback function that the thread is going to execute.
+ * @param param The parameter to be passed into the callback function.
+ * @return dccthread_t*
+ */
+dccthread_t* dccthread_create_on(scheduler_t* sched,
+                                 const char* name,
+                                 void (*func)(int),
+                                 int param);
+
+/**
+ * @brief Runs a blocking function on the offload pool, an internal set of OS
+ * threads, so that it doesn't stall the other threads. The current thread is
+ * blocked until <func> returns.
+ *
+ * @param func The function to be run outside of the scheduler.
+ * @param arg The argument to be passed into <func>.
+ * @return void* The value returned by <func>.
+ */
+void* dccthread_offload(void* (*func)(void*), void* arg);
+
+/**
+ * @brief Function that sets the number of OS threads of the offload pool. Only
+ * has effect before the first `dccthread_offload`. Defaults to 4.
+ *
+ * @param n Number of OS threads.
+ */
+void dccthread_set_offload_threads(int n);
+
+/**
+ * @brief Function that returns the scheduler clock. When DCCTHREAD_VIRTUAL_TIME
+ * is enabled this is the virtual clock, otherwise it is CLOCK_MONOTONIC.
+ *
+ * @return struct timespec The current time.
+ */
+struct timespec dccthread_now(void);
+
+/**
+ * @brief Creates a generator: a coroutine with its own stack that runs on the
+ * thread consuming it, handing values over with `dccthread_yield_value`.
+ * Generators are never seen by the scheduler and must not call
+ * `dccthread_exit`.
+ *
+ * @param func The generator body. The generator is done when it returns.
+ * @param param Parameter to be passed to <func>.
+ * @return dccthread_gen_t* the generator, NULL if it couldn't be allocated.
+ */
+dccthread_gen_t* dccthread_gen_create(void (*func)(void*), void* param);
+
+/**
+ * @brief Runs a generator until it yields its next value. Must be called from
+ * a thread, or from another generator.
+ *
+ * @param gen The generator.
+ * @return void* the value given to `dccthread_yield_value`, NULL once the
+ * generator is done.
+ */
+void* dccthread_gen_next(dccthread_gen_t* gen);
+
+/**
+ * @brief Function that tells if a generator body has returned.
+ *
+ * @param gen The generator.
+ * @return int 1 if it is done, 0 otherwise.
+ */
+int dccthread_gen_done(dccthread_gen_t* gen);
+
+/**
+ * @brief Frees a generator, whether it is done or not.
+ *
+ * @param gen The generator.
+ */
+void dccthread_gen_destroy(dccthread_gen_t* gen);
+
+/**
+ * @brief Hands <value> to the consumer of the current generator and suspends it
+ * until the next `dccthread_gen_next`. The pointer is passed as is. Does
+ * nothing when not called from inside a generator.
+ *
+ * @param value The value.
+ */
+void dccthread_yield_value(void* value);
 
 /**
  * @brief Function that returns the current thread being executed.
@@ -76,6 +581,132 @@ dccthread_t* dccthread_self(void);
  */
 const char* dccthread_name(dccthread_t* tid);
 
+/**
+ * @brief Creates a key for thread specific values, visible to all the threads.
+ * Every thread starts with the value NULL.
+ *
+ * @param key Where the new key is stored.
+ * @param destructor Function called in `dccthread_exit` with the exiting thread
+ * value, if it isn't NULL. May be NULL.
+ * @return int 0 on success, -1 if DCCTHREAD_KEYS_MAX keys were already created.
+ */
+int dccthread_key_create(dccthread_key_t* key, void (*destructor)(void*));
+
+/**
+ * @brief Function that returns the current thread value for a key.
+ *
+ * @param key The key created by `dccthread_key_create`.
+ * @return void* The value, NULL if it was never set.
+ */
+void* dccthread_getspecific(dccthread_key_t key);
+
+/**
+ * @brief Function that sets the current thread value for a key.
+ *
+ * @param key The key created by `dccthread_key_create`.
+ * @param value The value.
+ * @return int 0 on success, -1 if the key is invalid.
+ */
+int dccthread_setspecific(dccthread_key_t key, const void* value);
+
+/**
+ * @brief Allocates memory from the current thread region. Allocations are a
+ * pointer bump into chunks kept by the scheduler, and the whole region is
+ * released at once in `dccthread_exit`, after the key destructors. The memory
+ * must not be passed to free nor used by other threads after the owner exits.
+ *
+ * @param size The number of bytes.
+ * @return void* Memory aligned to 16 bytes, NULL if out of memory or not
+ * called from a thread.
+ */
+void* dccthread_alloc(size_t size);
+
+/**
+ * @brief Releases everything allocated by the current thread with
+ * `dccthread_alloc`, so that long lived threads can reuse their region, for
+ * instance once per request.
+ *
+ */
+void dccthread_arena_reset(void);
+
+/**
+ * @brief Function that limits the memory committed to threads and the number
+ * of live threads, for the whole process.
+ *
+ * @param max_bytes Limit on descriptor and stack bytes, 0 for no limit.
+ * @param max_threads Limit on live threads, 0 for no limit.
+ * @param policy DCCTHREAD_LIMIT_FAIL to make `dccthread_create` return NULL
+ * when a limit is hit, DCCTHREAD_LIMIT_BLOCK to block the calling thread until
+ * enough threads exit, on any scheduler of the process (threads created from
+ * other OS threads always fail). The wait is untimed, see
+ * `dccthread_create_in_group_timeout` to bound it.
+ */
+void dccthread_set_limits(size_t max_bytes, int max_threads, int policy);
+
+/**
+ * @brief Function that sets how long a thread must stay blocked (sleeping,
+ * waiting, parked...) before the unused part of its stack, below the saved
+ * stack pointer, is given back to the OS. Defaults to 1s.
+ *
+ * @param threshold The time blocked, zero to never reclaim.
+ */
+void dccthread_set_reclaim_threshold(struct timespec threshold);
+
+/**
+ * @brief Function that returns the memory committed to threads.
+ *
+ * @param stats Where the totals and limits are stored.
+ */
+void dccthread_mem_stats(struct dccthread_mem_stats* stats);
+
+/**
+ * @brief Starts the sampling profiler. Every 1/<hz> seconds of scheduler CPU
+ * time the interrupted code is sampled, walking its frame pointers, and tagged
+ * with the name of the running thread. Programs must keep the frame pointers
+ * (-fno-omit-frame-pointer) and be linked with -rdynamic for the functions to
+ * be named. Must be called from a thread.
+ *
+ * @param hz Samples per second.
+ * @return int 0 on success, -1 if the profiler is already running or couldn't
+ * be started.
+ */
+int dccthread_profile_start(int hz);
+
+/**
+ * @brief Stops the sampling profiler and writes the samples in folded stack
+ * format, one "thread;outer;...;inner count" line per distinct stack, ready for
+ * flamegraph.pl.
+ *
+ * @param out Where the samples are written.
+ * @return int number of samples written, -1 if the profiler wasn't running or
+ * there was no memory to sort the samples, in which case they are dropped.
+ */
+int dccthread_profile_stop(FILE* out);
+
+/**
+ * @brief Writes a snapshot of every thread: its state and for how long it is
+ * in it, the thread it waits for, its stack usage and a backtrace from its
+ * saved context, followed by the wait cycles among the threads. Backtraces
+ * need the frame pointers and -rdynamic, as for the profiler.
+ *
+ * @param out Where the snapshot is written.
+ */
+void dccthread_dump(FILE* out);
+
+/**
+ * @brief Makes the signal <signo> (SIGQUIT, for instance) write a
+ * `dccthread_dump` of every scheduler of the process to <out>, whichever OS
+ * thread the signal lands on. The scheduler calling this one passes the request
+ * on to the others, and each writes its dump in one piece on its next pass, not
+ * from the signal handler. The signal does nothing once the OS thread of that
+ * scheduler has exited.
+ *
+ * @param signo The signal triggering the dump.
+ * @param out Where the snapshots are written.
+ * @return int 0 on success, -1 if the signal can't be caught.
+ */
+int dccthread_dump_on_signal(int signo, FILE* out);
+
 /**
  * @brief Function that returns the number of threads that are currently waiting
  * for another one.
@@ -84,6 +715,14 @@ const char* dccthread_name(dccthread_t* tid);
  */
 int dccthread_nwaiting();
 
+/**
+ * @brief Function that returns the number of threads that are currently blocked
+ * on `dccthread_offload`.
+ *
+ * @return int number of offloads in flight.
+ */
+int dccthread_noffloaded();
+
 /**
  * @brief Function that returns the number of threads that have been exited and
  * were never a target of the waiting function.
@@ -93,4 +732,39 @@ int dccthread_nwaiting();
  */
 int dccthread_nexited();
 
+/**
+ * @brief Publishes the counters of the calling OS thread scheduler to the
+ * shared memory segment <name> (as given to shm_open, under /dev/shm), created
+ * if needed. They are updated on every thread switch with plain stores, so
+ * other processes can read them at any rate without slowing the scheduler
+ * down. The segment is left behind when the process exits.
+ *
+ * @param name The segment name, such as "/dccthread.1234".
+ * @return int 0 on success, -1 if the scheduler isn't created or the segment
+ * couldn't be mapped.
+ */
+int dccthread_stats_export(const char* name);
+
+/**
+ * @brief Takes a consistent snapshot of the counters published by
+ * `dccthread_stats_export`, retrying while the scheduler updates them. Needs no
+ * system call nor lock.
+ *
+ * @param shm The mapped segment.
+ * @param out Where the snapshot is stored.
+ * @return int 0 on success, -1 if no consistent snapshot could be taken.
+ */
+static inline int dccthread_stats_read(const struct dccthread_shm_stats* shm,
+                                       struct dccthread_shm_stats* out) {
+    for(int tries = 0; tries < 1000; tries++) {
+        u_int64_t seq = shm->seq;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(seq & 1) continue;
+        memcpy(out, (const void*)shm, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(shm->seq == seq) return 0;
+    }
+    return -1;
+}
+
 #endif
@@ -172,4 +172,48 @@ void dlist_remove_from_node(struct dlist* dl, struct dnode* node) /* {{{ */
     }
 
     dl->count--;
-} /* {{{ */
\ No newline at end of file
+} /* {{{ */
+void dlist_link_left(struct dlist* dl, struct dnode* node) /* {{{ */
+{
+    node->prev = NULL;
+    node->next = dl->head;
+
+    if(dl->head) dl->head->prev = node;
+    dl->head = node;
+
+    if(dl->tail == NULL) dl->tail = node;
+
+    dl->count++;
+} /* }}} */
+
+void dlist_link_right(struct dlist* dl, struct dnode* node) /* {{{ */
+{
+    dlist_splice_right(dl, node, node, 1);
+} /* }}} */
+
+void dlist_splice_right(struct dlist* dl,
+                        struct dnode* first, /* {{{ */
+                        struct dnode* last,
+                        int count) {
+    first->prev = dl->tail;
+    last->next = NULL;
+
+    if(dl->tail) dl->tail->next = first;
+    dl->tail = last;
+
+    if(dl->head == NULL) dl->head = first;
+
+    dl->count += count;
+} /* }}} */
+
+void dlist_unlink(struct dlist* dl, struct dnode* node) /* {{{ */
+{
+    if(node->prev) node->prev->next = node->next;
+    else dl->head = node->next;
+    if(node->next) node->next->prev = node->prev;
+    else dl->tail = node->prev;
+
+    node->prev = NULL;
+    node->next = NULL;
+    dl->count--;
+} /* }}} */
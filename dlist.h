@@ -40,4 +40,16 @@ void dlist_set_index(struct dlist* dl, int idx, void* data);
 /* remove the node from the list in O(1) */
 void dlist_remove_from_node(struct dlist* dl, struct dnode* node);
 
+/* the functions below work on nodes owned by the caller, which are never
+ * allocated nor freed by the list. */
+void dlist_link_left(struct dlist* dl, struct dnode* node);
+void dlist_link_right(struct dlist* dl, struct dnode* node);
+/* appends the =count nodes already chained from =first to =last in O(1). */
+void dlist_splice_right(struct dlist* dl,
+                        struct dnode* first,
+                        struct dnode* last,
+                        int count);
+/* takes the node out of the list in O(1), without freeing it. */
+void dlist_unlink(struct dlist* dl, struct dnode* node);
+
 #endif
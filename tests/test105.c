@@ -18,6 +18,7 @@ void waitOrNot(int i) {
         else {
             struct timespec ts;
             ts.tv_sec = 5;
+            ts.tv_nsec = 0;
             dccthread_sleep(ts);
         }
     }
@@ -36,6 +37,7 @@ void test(int cont) {
 
     struct timespec ts;
     ts.tv_sec = 6;
+    ts.tv_nsec = 0;
     dccthread_sleep(ts);
     printf(
         "Thread %s executada aqui com argumento %d. Agora, após o fim de tudo, "
@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+#define NUM_THREADS 5
+dccthread_t* threads[NUM_THREADS];
+
+void tsleep(int seconds) {
+    struct timespec ts;
+    ts.tv_sec = seconds;
+    ts.tv_nsec = 0;
+    dccthread_sleep(ts);
+    printf("thread %s woke up at %lds\n",
+           dccthread_name(dccthread_self()),
+           (long)dccthread_now().tv_sec);
+    dccthread_exit();
+}
+
+// Função de teste para o modo de tempo virtual: as threads dormem por minutos
+// mas o teste termina imediatamente, acordando na mesma ordem do tempo real
+void test(int dummy) {
+    int secs[NUM_THREADS] = {300, 60, 600, 60, 5};
+    for(int i = 0; i < NUM_THREADS; i++) {
+        char name[16];
+        sprintf(name, "sleep%d", i);
+        threads[i] = dccthread_create(name, tsleep, secs[i]);
+    }
+    for(int i = 0; i < NUM_THREADS; i++) {
+        dccthread_wait(threads[i]);
+    }
+    printf("main thread exiting at %lds\n", (long)dccthread_now().tv_sec);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) {
+    dccthread_init_flags(test, 0, DCCTHREAD_VIRTUAL_TIME);
+}
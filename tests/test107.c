@@ -0,0 +1,42 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+dccthread_t* main_thread;
+dccthread_t* remote_thread;
+
+void remote(int dummy) {
+    printf("Thread %s criada por outra thread do SO com argumento %d\n",
+           dccthread_name(dccthread_self()),
+           dummy);
+    dccthread_exit();
+}
+
+void* helper(void* arg) {
+    // Cria uma thread e acorda a main a partir de outra thread do SO
+    remote_thread = dccthread_create_remote("remote", remote, 3);
+    dccthread_wake_remote(main_thread);
+    return NULL;
+}
+
+// Função de teste para dccthread_create_remote e dccthread_wake_remote
+void test(int dummy) {
+    pthread_t pthread;
+    main_thread = dccthread_self();
+    pthread_create(&pthread, NULL, helper, NULL);
+
+    dccthread_park();
+    dccthread_wait(remote_thread);
+    printf("Thread %s acordada\n", dccthread_name(dccthread_self()));
+    pthread_join(pthread, NULL);
+
+    // Um wake up antes do park faz o park retornar imediatamente
+    dccthread_wake_remote(main_thread);
+    dccthread_yield();
+    dccthread_park();
+    printf("Thread %s terminando\n", dccthread_name(dccthread_self()));
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
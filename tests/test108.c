@@ -0,0 +1,30 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "dccthread.h"
+
+void* slow_double(void* arg) {
+    // Uma chamada bloqueante que travaria todas as threads
+    usleep(200000);
+    return (void*)((long)arg * 2);
+}
+
+void other(int dummy) {
+    printf("Thread %s executando com %d offload(s) em andamento\n",
+           dccthread_name(dccthread_self()),
+           dccthread_noffloaded());
+    dccthread_exit();
+}
+
+// Função de teste para dccthread_offload
+void test(int dummy) {
+    dccthread_create("other", other, 0);
+    long result = (long)dccthread_offload(slow_double, (void*)(long)dummy);
+    printf("Thread %s recebeu %ld, restam %d offload(s) em andamento\n",
+           dccthread_name(dccthread_self()),
+           result,
+           dccthread_noffloaded());
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 21); }
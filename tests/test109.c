@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+#define NUM_KEYS 12
+dccthread_key_t keys[NUM_KEYS];
+
+void destructor(void* value) {
+    printf("Thread %s destruindo valor %ld\n",
+           dccthread_name(dccthread_self()),
+           (long)value);
+}
+
+void worker(int id) {
+    // Metade das chaves fica no vetor da thread e o resto na tabela extra
+    for(int i = 0; i < NUM_KEYS; i++) {
+        dccthread_setspecific(keys[i], (void*)(long)(id * 100 + i));
+    }
+    dccthread_yield();
+    long sum = 0;
+    for(int i = 0; i < NUM_KEYS; i++) {
+        sum += (long)dccthread_getspecific(keys[i]);
+    }
+    printf("Thread %s soma %ld\n", dccthread_name(dccthread_self()), sum);
+    // Só as chaves com destrutor e valor não nulo são destruídas
+    for(int i = 0; i < NUM_KEYS - 2; i++) {
+        dccthread_setspecific(keys[i], NULL);
+    }
+    dccthread_exit();
+}
+
+// Função de teste para dccthread_key_create/getspecific/setspecific
+void test(int dummy) {
+    for(int i = 0; i < NUM_KEYS; i++) {
+        dccthread_key_create(&keys[i], destructor);
+    }
+    printf("Valor inicial %p\n", dccthread_getspecific(keys[NUM_KEYS - 1]));
+
+    dccthread_t* t1 = dccthread_create("t1", worker, 1);
+    dccthread_t* t2 = dccthread_create("t2", worker, 2);
+    dccthread_wait(t1);
+    dccthread_wait(t2);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+int global = 0;
+
+// Mesmo teste do test9, mas no modo cooperativo: os laços só trocam de thread
+// nos checkpoints
+void tloop(int cnt) {
+    int i;
+    for(i = 0; i < cnt; i++) {
+        if(global & 0x1) {
+            global |= 0x2;
+        }
+        if(global & 0x4) {
+            global |= 0x8;
+        }
+        dccthread_checkpoint();
+    }
+    dccthread_exit();
+}
+
+void test(int cnt) {
+    dccthread_t* t = dccthread_create("aux", tloop, cnt);
+    global |= 0x1;
+    int i;
+    for(i = 0; i < cnt; i++) {
+        if(global & 0x2) {
+            global |= 0x4;
+        }
+        dccthread_checkpoint();
+    }
+    printf("global counter is 0x%x\n", global);
+    dccthread_wait(t);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) {
+    dccthread_init_flags(test, 100000000, DCCTHREAD_COOPERATIVE);
+}
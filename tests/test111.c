@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+void print_stats(void) {
+    struct dccthread_mem_stats stats;
+    dccthread_mem_stats(&stats);
+    printf("%d de %d threads, %zu stacks\n",
+           stats.threads,
+           stats.max_threads,
+           stats.bytes / THREAD_STACK_SIZE);
+}
+
+void worker(int id) {
+    dccthread_yield();
+    printf("Thread %s terminando\n", dccthread_name(dccthread_self()));
+    dccthread_exit();
+}
+
+// Função de teste para dccthread_set_limits e dccthread_mem_stats
+void test(int dummy) {
+    dccthread_set_limits(0, 3, DCCTHREAD_LIMIT_FAIL);
+    dccthread_t* w1 = dccthread_create("w1", worker, 1);
+    dccthread_create("w2", worker, 2);
+    print_stats();
+    // Limite atingido: a criação falha
+    if(!dccthread_create("w3", worker, 3)) printf("w3 nao foi criada\n");
+
+    // Agora a criação espera alguma thread terminar
+    dccthread_set_limits(0, 3, DCCTHREAD_LIMIT_BLOCK);
+    dccthread_t* w3 = dccthread_create("w3", worker, 3);
+    printf("w3 criada\n");
+    print_stats();
+    dccthread_wait(w1);
+    dccthread_wait(w3);
+    print_stats();
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
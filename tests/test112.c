@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+#define NUM_THREADS 3
+dccthread_t* threads[NUM_THREADS];
+
+struct timespec ms(long n) {
+    struct timespec ts = {n / 1000, (n % 1000) * 1000000};
+    return ts;
+}
+
+long now_ms(void) {
+    struct timespec ts = dccthread_now();
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void job(int dummy) {
+    for(int i = 0; i < 3; i++) {
+        printf("thread %s step %d\n", dccthread_name(dccthread_self()), i);
+        dccthread_yield();
+    }
+    dccthread_deadline_done();
+    printf("thread %s done\n", dccthread_name(dccthread_self()));
+    dccthread_exit();
+}
+
+void periodic(int dummy) {
+    for(int i = 0; i < 3; i++) {
+        printf("thread %s released at %ldms\n",
+               dccthread_name(dccthread_self()),
+               now_ms());
+        dccthread_deadline_done();
+    }
+    dccthread_exit();
+}
+
+void late(int dummy) {
+    dccthread_sleep(ms(20));
+    dccthread_deadline_done();
+    printf("thread %s missed %d deadline(s)\n",
+           dccthread_name(dccthread_self()),
+           dccthread_deadline_misses(dccthread_self()));
+    dccthread_exit();
+}
+
+// Função de teste para a classe de prazo mais cedo primeiro: as threads com
+// prazo mais próximo rodam antes, mesmo cedendo a vez
+void test(int dummy) {
+    int deadlines[NUM_THREADS] = {30, 10, 20};
+    for(int i = 0; i < NUM_THREADS; i++) {
+        char name[16];
+        sprintf(name, "edf%d", deadlines[i]);
+        threads[i] = dccthread_create(name, job, 0);
+        dccthread_set_deadline(threads[i], ms(deadlines[i]), ms(0), ms(0));
+    }
+    for(int i = 0; i < NUM_THREADS; i++) {
+        dccthread_wait(threads[i]);
+    }
+
+    dccthread_t* p = dccthread_create("periodic", periodic, 0);
+    dccthread_set_deadline(p, ms(50), ms(100), ms(0));
+    dccthread_wait(p);
+
+    dccthread_t* l = dccthread_create("late", late, 0);
+    dccthread_set_deadline(l, ms(10), ms(0), ms(0));
+    dccthread_wait(l);
+
+    printf("main thread exiting with %d missed deadline(s)\n",
+           dccthread_deadline_misses(NULL));
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) {
+    dccthread_init_flags(test, 0, DCCTHREAD_VIRTUAL_TIME);
+}
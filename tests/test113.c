@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+#define NUM_THREADS 2
+dccthread_t* threads[NUM_THREADS];
+
+void busy(int dummy) {
+    volatile unsigned long sum = 0;
+    for(unsigned long i = 0; i < 100000000; i++) {
+        sum += i;
+    }
+    dccthread_exit();
+}
+
+// Função de teste para o profiler: as amostras de cada thread aparecem em
+// linhas próprias, com o nome da thread como raiz da pilha
+void test(int dummy) {
+    FILE* out = tmpfile();
+    dccthread_profile_start(1000);
+    for(int i = 0; i < NUM_THREADS; i++) {
+        char name[16];
+        sprintf(name, "busy%d", i);
+        threads[i] = dccthread_create(name, busy, 0);
+    }
+    for(int i = 0; i < NUM_THREADS; i++) {
+        dccthread_wait(threads[i]);
+    }
+    int n = dccthread_profile_stop(out);
+    printf("profiler stopped %s\n", n > 0 ? "with samples" : "empty");
+
+    int counts[NUM_THREADS] = {0};
+    char line[4096];
+    rewind(out);
+    while(fgets(line, sizeof(line), out)) {
+        int i, count;
+        char* last = strrchr(line, ' ');
+        if(sscanf(line, "busy%d;", &i) == 1 && i >= 0 && i < NUM_THREADS
+           && last && sscanf(last, "%d", &count) == 1) {
+            counts[i] += count;
+        }
+    }
+    for(int i = 0; i < NUM_THREADS; i++) {
+        printf("busy%d %s\n", i, counts[i] > 0 ? "sampled" : "not sampled");
+    }
+    fclose(out);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+#define NUM_THREADS 4
+#define NUM_ITERS 1000
+dccthread_t* threads[NUM_THREADS];
+
+// 0: livre, 1: travado, 2: travado com threads esperando
+volatile int mutex = 0;
+int counter = 0;
+
+void lock(void) {
+    int c = __sync_val_compare_and_swap(&mutex, 0, 1);
+    if(c == 0) return;
+    if(c != 2) c = __sync_lock_test_and_set(&mutex, 2);
+    while(c != 0) {
+        dccthread_park_on(&mutex, 2);
+        c = __sync_lock_test_and_set(&mutex, 2);
+    }
+}
+
+void unlock(void) {
+    if(__sync_fetch_and_sub(&mutex, 1) != 1) {
+        mutex = 0;
+        dccthread_unpark(&mutex, 1);
+    }
+}
+
+void increment(int dummy) {
+    for(int i = 0; i < NUM_ITERS; i++) {
+        lock();
+        int value = counter;
+        // Cede a vez dentro da seção crítica para forçar a contenção
+        dccthread_yield();
+        counter = value + 1;
+        unlock();
+    }
+    dccthread_exit();
+}
+
+// Função de teste para park_on/unpark: um mutex feito sobre eles mantém o
+// contador correto mesmo cedendo a vez dentro da seção crítica
+void test(int dummy) {
+    volatile int value = 1;
+    printf("park_on with a stale value returns %d\n",
+           dccthread_park_on(&value, 0));
+    printf("unpark with no waiters wakes %d\n", dccthread_unpark(&value, 1));
+
+    for(int i = 0; i < NUM_THREADS; i++) {
+        char name[16];
+        sprintf(name, "inc%d", i);
+        threads[i] = dccthread_create(name, increment, 0);
+    }
+    for(int i = 0; i < NUM_THREADS; i++) {
+        dccthread_wait(threads[i]);
+    }
+    printf("counter is %d, expected %d\n", counter, NUM_THREADS * NUM_ITERS);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
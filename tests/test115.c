@@ -0,0 +1,47 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+void steps(int dummy) {
+    for(int i = 0; i < 3; i++) {
+        printf("thread %s step %d\n", dccthread_name(dccthread_self()), i);
+        dccthread_yield();
+    }
+    dccthread_exit();
+}
+
+void sleeper(int ms) {
+    struct timespec ts = {0, ms * 1000000};
+    if(ms < 10)
+        dccthread_sleep_precise(ts);
+    else
+        dccthread_sleep(ts);
+    printf("thread %s woke up\n", dccthread_name(dccthread_self()));
+    dccthread_exit();
+}
+
+// Teste do escalonador embutido: o laço do programa espera no descritor e
+// roda as threads aos poucos, e main retorna normalmente no final
+int main(int argc, char** argv) {
+    struct timespec no_budget = {0, 0};
+    if(dccthread_sched_create(0) == -1) {
+        printf("couldn't create the scheduler\n");
+        return 1;
+    }
+    dccthread_create("steps", steps, 0);
+    dccthread_create("sleep20", sleeper, 20);
+    dccthread_create("sleep5", sleeper, 5);
+
+    struct pollfd pfd = {dccthread_sched_fd(), POLLIN, 0};
+    printf("ready before running: %d\n", poll(&pfd, 1, 0));
+    printf("dispatched %d of at most 1\n", dccthread_run_once(1, no_budget));
+    printf("ready with runnable threads: %d\n", poll(&pfd, 1, 0));
+
+    while(dccthread_nthreads()) {
+        poll(&pfd, 1, -1);
+        dccthread_run_once(2, no_budget);
+    }
+    printf("host loop finished\n");
+    return 0;
+}
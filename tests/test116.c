@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+#define NUM_ITEMS 5
+#define NUM_LONG 200000
+
+int items[NUM_ITEMS] = {1, 2, 3, 4, 5};
+
+void parse(void* param) {
+    int* values = param;
+    for(int i = 0; i < NUM_ITEMS; i++) {
+        dccthread_yield_value(&values[i]);
+    }
+}
+
+void transform(void* param) {
+    dccthread_gen_t* source = param;
+    int* value;
+    while((value = dccthread_gen_next(source))) {
+        *value *= 10;
+        dccthread_yield_value(value);
+    }
+}
+
+void count(void* param) {
+    for(long i = 1; i <= NUM_LONG; i++) {
+        dccthread_yield_value((void*)i);
+    }
+}
+
+void other(int dummy) {
+    printf("thread %s ran while the generators were alive\n",
+           dccthread_name(dccthread_self()));
+    dccthread_exit();
+}
+
+// Teste dos geradores: um pipeline passa ponteiros sem cópia entre os
+// estágios, e um gerador longo continua correto com a preempção
+void test(int dummy) {
+    dccthread_gen_t* source = dccthread_gen_create(parse, items);
+    dccthread_gen_t* stage = dccthread_gen_create(transform, source);
+    int* value;
+    while((value = dccthread_gen_next(stage))) {
+        printf("item %d at index %ld\n", *value, (long)(value - items));
+    }
+    printf("generators done: %d %d\n",
+           dccthread_gen_done(source),
+           dccthread_gen_done(stage));
+    dccthread_gen_destroy(stage);
+    dccthread_gen_destroy(source);
+
+    dccthread_t* t = dccthread_create("other", other, 0);
+    dccthread_gen_t* counter = dccthread_gen_create(count, NULL);
+    printf("live threads: %d\n", dccthread_nthreads());
+    long sum = 0, n;
+    while((n = (long)dccthread_gen_next(counter))) sum += n;
+    printf("sum is %ld, expected %ld\n",
+           sum,
+           (long)NUM_LONG * (NUM_LONG + 1) / 2);
+    dccthread_gen_destroy(counter);
+    dccthread_wait(t);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
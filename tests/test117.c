@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+#define NUM_THREADS 200
+dccthread_t* threads[NUM_THREADS];
+int finished = 0;
+
+void work(int depth) {
+    // Use a good part of the stack before giving the CPU away
+    volatile char buffer[16384];
+    buffer[0] = depth;
+    buffer[sizeof(buffer) - 1] = depth;
+    dccthread_yield();
+    if(buffer[0] == depth && buffer[sizeof(buffer) - 1] == depth) finished++;
+    dccthread_exit();
+}
+
+// Teste da arena de pilhas: duas levas de threads, a segunda reaproveitando as
+// pilhas da primeira
+void test(int dummy) {
+    for(int round = 0; round < 2; round++) {
+        finished = 0;
+        for(int i = 0; i < NUM_THREADS; i++) {
+            threads[i] = dccthread_create("worker", work, i % 100);
+        }
+        for(int i = 0; i < NUM_THREADS; i++) {
+            dccthread_wait(threads[i]);
+        }
+        printf("round %d: %d of %d threads finished\n",
+               round,
+               finished,
+               NUM_THREADS);
+    }
+
+    struct dccthread_mem_stats stats;
+    dccthread_mem_stats(&stats);
+    printf("threads left: %d\n", stats.threads);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) {
+    dccthread_init_flags(test, 0, DCCTHREAD_STACK_ARENA);
+}
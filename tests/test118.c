@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+#define NUM_THREADS 4
+dccthread_t* threads[NUM_THREADS];
+int intact = 0;
+
+void deep(int n) {
+    // Touch most of the stack, which is dead once this returns
+    volatile char buffer[40960];
+    for(int i = 0; i < sizeof(buffer); i += 1024) buffer[i] = n;
+}
+
+void sleeper(int id) {
+    volatile int value = id * 1000;
+    deep(id);
+
+    struct timespec ts = {0, 300000000};
+    dccthread_sleep(ts);
+    if(value == id * 1000) intact++;
+    dccthread_exit();
+}
+
+// Teste da recuperação de pilha: threads dormindo por mais que o limite
+// devolvem a parte não usada da pilha, sem perder o que está acima dela
+void test(int dummy) {
+    struct timespec threshold = {0, 50000000};
+    dccthread_set_reclaim_threshold(threshold);
+
+    for(int i = 0; i < NUM_THREADS; i++) {
+        threads[i] = dccthread_create("sleeper", sleeper, i + 1);
+    }
+    for(int i = 0; i < NUM_THREADS; i++) {
+        dccthread_wait(threads[i]);
+    }
+
+    struct dccthread_mem_stats stats;
+    dccthread_mem_stats(&stats);
+    printf("%d of %d threads woke up with their stack intact\n",
+           intact,
+           NUM_THREADS);
+    printf("reclaimed at least 32 KiB per sleeper: %s\n",
+           stats.reclaimed >= NUM_THREADS * 32768 ? "yes" : "no");
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
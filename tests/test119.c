@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+volatile int flag = 0;
+
+struct timespec ms(long n) {
+    struct timespec ts;
+    ts.tv_sec = n / 1000;
+    ts.tv_nsec = (n % 1000) * 1000000;
+    return ts;
+}
+
+void slow(int dummy) {
+    dccthread_sleep(ms(200));
+    printf("slow done\n");
+    dccthread_exit();
+}
+
+void waker(int dummy) {
+    dccthread_sleep(ms(20));
+    flag = 1;
+    printf("waker unparks %d\n", dccthread_unpark(&flag, 1));
+    dccthread_exit();
+}
+
+// Função de teste para as esperas com timeout: quem desiste sai da fila do
+// alvo, que ainda pode ser esperado de novo
+void test(int dummy) {
+    dccthread_t* t = dccthread_create("slow", slow, 0);
+    printf("wait for slow with 50ms: %d\n", dccthread_wait_timeout(t, ms(50)));
+    printf("threads waiting: %d\n", dccthread_nwaiting());
+    printf("wait for slow with 1s: %d\n", dccthread_wait_timeout(t, ms(1000)));
+
+    printf("park with 20ms: %d\n", dccthread_park_timeout(ms(20)));
+    printf("park_on with 20ms: %d\n",
+           dccthread_park_on_timeout(&flag, 0, ms(20)));
+    printf("unpark after the timeout wakes %d\n", dccthread_unpark(&flag, 1));
+
+    dccthread_create("waker", waker, 0);
+    printf("park_on with 1s: %d\n",
+           dccthread_park_on_timeout(&flag, 0, ms(1000)));
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
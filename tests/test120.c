@@ -0,0 +1,62 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dccthread.h"
+
+dccthread_t* a;
+dccthread_t* b;
+volatile int flag = 0;
+
+void wait_b(int dummy) { dccthread_wait(b); }
+
+void wait_a(int dummy) { dccthread_wait(a); }
+
+void park(int dummy) { dccthread_park_on(&flag, 0); }
+
+void nap(int dummy) {
+    struct timespec ts = {10, 0};
+    dccthread_sleep(ts);
+}
+
+int count(const char* text, const char* pattern) {
+    int n = 0;
+    for(const char* p = strstr(text, pattern); p; p = strstr(p + 1, pattern))
+        n++;
+    return n;
+}
+
+// Função de teste para o dump: estados, quem espera quem, o ciclo de espera
+// entre "a" e "b" e o dump pedido por sinal
+void test(int dummy) {
+    a = dccthread_create("a", wait_b, 0);
+    b = dccthread_create("b", wait_a, 0);
+    dccthread_create("park", park, 0);
+    dccthread_create("nap", nap, 0);
+    dccthread_yield();
+
+    char* text;
+    size_t size;
+    FILE* out = open_memstream(&text, &size);
+    dccthread_dump(out);
+    fclose(out);
+    printf("header: %d\n", count(text, "dccthread dump: 5 threads, 2 waiting"));
+    printf("main running: %d\n", count(text, "thread \"main\" RUNNING"));
+    printf("waiting: %d\n", count(text, "WAITING for "));
+    printf("a waits for b: %d\n", count(text, "waits for \"b\""));
+    printf("parked on: %d\n", count(text, "parked on "));
+    printf("times out: %d\n", count(text, "times out in "));
+    printf("backtraces: %d\n", count(text, "    #0 "));
+    printf("cycles: %d\n", count(text, "wait cycle: "));
+    free(text);
+
+    out = open_memstream(&text, &size);
+    dccthread_dump_on_signal(SIGQUIT, out);
+    raise(SIGQUIT);
+    dccthread_yield();
+    fflush(out);
+    printf("dump on signal: %d\n", count(text, "dccthread dump: "));
+    exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
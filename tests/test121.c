@@ -0,0 +1,57 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+#define NUM_SHARDS 2
+#define NUM_WORKERS 4
+#define NUM_ITERS 1000
+
+struct shard {
+    pthread_t pthread;
+    int affinity;
+    volatile int counter;
+} shards[NUM_SHARDS];
+
+void work(int id) {
+    struct timespec ts = {0, 10000000};
+    dccthread_sleep(ts);
+    for(int i = 0; i < NUM_ITERS; i++) {
+        shards[id].counter++;
+        dccthread_yield();
+    }
+}
+
+// Só termina se a preempção do seu próprio escalonador o interromper
+void spin(int id) {
+    while(!shards[id].counter)
+        ;
+}
+
+void* shard_main(void* arg) {
+    struct shard* shard = arg;
+    int id = shard - shards;
+    shard->affinity = dccthread_sched_affinity(0);
+    if(dccthread_sched_create(0) == -1) return NULL;
+    dccthread_create("spin", spin, id);
+    for(int i = 0; i < NUM_WORKERS; i++) dccthread_create("work", work, id);
+    dccthread_sched_run();
+    return NULL;
+}
+
+// Função de teste para os escalonadores independentes: cada thread do SO roda
+// o seu, com suas próprias threads, temporizadores e preempção
+int main(int argc, char** argv) {
+    for(int i = 0; i < NUM_SHARDS; i++)
+        pthread_create(&shards[i].pthread, NULL, shard_main, &shards[i]);
+    for(int i = 0; i < NUM_SHARDS; i++) pthread_join(shards[i].pthread, NULL);
+
+    for(int i = 0; i < NUM_SHARDS; i++)
+        printf("shard %d: affinity %d, counter %d, expected %d\n",
+               i,
+               shards[i].affinity,
+               shards[i].counter,
+               NUM_WORKERS * NUM_ITERS);
+    printf("no scheduler on main: %d\n", dccthread_sched_self() == NULL);
+    return 0;
+}
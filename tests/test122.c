@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dccthread.h"
+
+volatile long counter = 0;
+volatile int done = 0;
+
+void count(int dummy) {
+    while(!done) counter++;
+}
+
+void spin_ms(long ms) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    do {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    } while((now.tv_sec - start.tv_sec) * 1000
+                + (now.tv_nsec - start.tv_nsec) / 1000000
+            < ms);
+}
+
+// Função de teste para preempt_disable/enable: nenhuma outra thread roda
+// enquanto a preempção está desligada, e a preempção adiada acontece logo que
+// ela é religada
+void test(int dummy) {
+    dccthread_t* t = dccthread_create("count", count, 0);
+
+    dccthread_preempt_disable();
+    dccthread_preempt_disable();
+    long before = counter;
+    spin_ms(30);
+    dccthread_preempt_enable();
+    spin_ms(30);
+    long after = counter;
+    // A preempção pendente troca de thread aqui mesmo
+    dccthread_preempt_enable();
+    printf("counter unchanged while disabled: %d\n", after == before);
+    printf("other thread ran on enable: %d\n", counter != after);
+
+    done = 1;
+    dccthread_wait(t);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
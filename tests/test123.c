@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+int sum = 0;
+
+void worker(int param) {
+    sum += param;
+    dccthread_exit();
+}
+
+void named(int param) {
+    printf("%s got %d\n", dccthread_name(dccthread_self()), param);
+    dccthread_exit();
+}
+
+// Função de teste para a criação em lote: os parâmetros, os nomes e os
+// limites valem para o lote inteiro
+void test(int dummy) {
+    dccthread_t* threads[100];
+    printf("create 100: %d\n",
+           dccthread_create_many(100, worker, NULL, NULL, threads));
+    for(int i = 0; i < 100; i++) dccthread_wait(threads[i]);
+    printf("sum of the indexes: %d\n", sum);
+
+    const int params[] = {10, 20, 30};
+    const char* const names[] = {"a", "b", "c"};
+    dccthread_create_many(3, named, params, names, threads);
+    for(int i = 0; i < 3; i++) dccthread_wait(threads[i]);
+
+    dccthread_set_limits(0, 10, DCCTHREAD_LIMIT_FAIL);
+    printf("create 20 over the limit: %d\n",
+           dccthread_create_many(20, worker, NULL, NULL, NULL));
+    printf("threads: %d\n", dccthread_nthreads());
+    printf("create 5 under the limit: %d\n",
+           dccthread_create_many(5, worker, NULL, NULL, NULL));
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dccthread.h"
+
+char* first = NULL;
+
+void request(int n) {
+    // Várias alocações pequenas, que sobrevivem só até o fim da thread
+    char* blocks[1000];
+    int aligned = 1;
+    for(int i = 0; i < 1000; i++) {
+        blocks[i] = dccthread_alloc(100 + i % 7);
+        aligned &= ((uintptr_t)blocks[i] % 16) == 0;
+        memset(blocks[i], i % 256, 100);
+    }
+    int intact = 1;
+    for(int i = 0; i < 1000; i++)
+        for(int j = 0; j < 100; j++) intact &= blocks[i][j] == (char)(i % 256);
+    printf("request %d: aligned %d, intact %d\n", n, aligned, intact);
+
+    char* large = dccthread_alloc(1 << 20);
+    memset(large, 1, 1 << 20);
+    printf("request %d: large %d\n", n, large != NULL);
+
+    // A thread seguinte recomeça no primeiro bloco que esta usou
+    if(n == 0) first = blocks[0];
+    else printf("request %d: chunk reused %d\n", n, blocks[0] == first);
+    dccthread_exit();
+}
+
+void worker(int dummy) {
+    char* a = dccthread_alloc(64);
+    for(int i = 0; i < 5000; i++) dccthread_alloc(64);
+    dccthread_arena_reset();
+    printf("worker: reset reuses the memory %d\n", dccthread_alloc(64) == a);
+    dccthread_exit();
+}
+
+// Função de teste para o alocador por thread: a memória some com a thread e
+// volta para o cache do escalonador
+void test(int dummy) {
+    dccthread_wait(dccthread_create("request", request, 0));
+    dccthread_wait(dccthread_create("request", request, 1));
+    dccthread_wait(dccthread_create("worker", worker, 0));
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
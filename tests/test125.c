@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dccthread.h"
+
+// Só no x86_64 a preempção não usa nada da pilha da thread
+#if defined(__x86_64__)
+#define HEADROOM 1024
+#else
+#define HEADROOM 16384
+#endif
+
+volatile int done = 0;
+int fp_ok[3];
+
+// Gasta tempo de CPU com contas de ponto flutuante que só dão o resultado
+// certo se os registradores sobreviverem às preempções
+void fp(int id) {
+    double x = id, y = 0;
+    for(long i = 0; i < 20000000; i++) {
+        y += x * 0.5;
+        x = x * 1.0000001 + 0.25;
+        if(x > 1e6) x -= 1e6;
+    }
+    double expected = id, check = 0;
+    for(long i = 0; i < 20000000; i++) {
+        check += expected * 0.5;
+        expected = expected * 1.0000001 + 0.25;
+        if(expected > 1e6) expected -= 1e6;
+    }
+    fp_ok[id] = y == check && x == expected;
+    done++;
+    dccthread_exit();
+}
+
+// Ocupa quase toda a pilha enquanto é preemptada: o handler do sinal não
+// pode usar a pilha da thread
+int fill(void) {
+    volatile char frame[THREAD_STACK_SIZE - HEADROOM];
+    memset((char*)frame, 7, sizeof(frame));
+    while(done < 2)
+        for(size_t i = 0; i < sizeof(frame); i += 64)
+            if(frame[i] != 7) return 0;
+    return 1;
+}
+
+void deep(int dummy) {
+    printf("deep: %s\n", fill() ? "ok" : "stack corrupted");
+    dccthread_exit();
+}
+
+// Função de teste para a preempção feita na pilha de sinais
+void test(int dummy) {
+    dccthread_t* a = dccthread_create("fp", fp, 1);
+    dccthread_t* b = dccthread_create("fp", fp, 2);
+    dccthread_t* c = dccthread_create("deep", deep, 0);
+    dccthread_wait(a);
+    dccthread_wait(b);
+    dccthread_wait(c);
+    for(int i = 1; i <= 2; i++)
+        printf("fp %d: %s\n", i, fp_ok[i] ? "ok" : "wrong");
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
@@ -0,0 +1,92 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "dccthread.h"
+
+volatile int flag = 0;
+char name[64];
+
+void sleeper(int dummy) {
+    struct timespec ts = {0, 200000000};
+    dccthread_sleep(ts);
+    dccthread_exit();
+}
+
+void waiter(int dummy) {
+    dccthread_wait(dccthread_create("sleeper", sleeper, 0));
+    dccthread_exit();
+}
+
+void parked(int dummy) {
+    dccthread_park_on(&flag, 0);
+    dccthread_exit();
+}
+
+void spin(int dummy) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // Gira por 50ms, o suficiente para ser preemptada
+    do clock_gettime(CLOCK_MONOTONIC, &now);
+    while((now.tv_sec - start.tv_sec) * 1000000000L
+              + (now.tv_nsec - start.tv_nsec)
+          < 50000000L);
+    dccthread_exit();
+}
+
+void print(const struct dccthread_shm_stats* shm) {
+    struct dccthread_shm_stats s;
+    if(dccthread_stats_read(shm, &s) == -1) {
+        printf("no snapshot\n");
+        return;
+    }
+    printf("live %lu running %lu runnable %lu waiting %lu sleeping %lu "
+           "parked %lu exited %lu\n",
+           (unsigned long)s.live,
+           (unsigned long)s.running,
+           (unsigned long)s.runnable,
+           (unsigned long)s.waiting,
+           (unsigned long)s.sleeping,
+           (unsigned long)s.parked,
+           (unsigned long)s.exited);
+}
+
+// Função de teste para os contadores exportados: lidos pelo segmento de
+// memória compartilhada, como faria outro processo
+void test(int dummy) {
+    snprintf(name, sizeof(name), "/dccthread-test126.%d", getpid());
+    printf("export: %d\n", dccthread_stats_export(name));
+    int fd = shm_open(name, O_RDONLY, 0);
+    const struct dccthread_shm_stats* shm = mmap(
+        NULL, sizeof(*shm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    printf("version %u\n", shm->version);
+
+    dccthread_create("waiter", waiter, 0);
+    dccthread_create("parked", parked, 0);
+    dccthread_create("sleeper", sleeper, 0);
+    // Todas bloqueiam, e a próxima troca publica o estado
+    dccthread_yield();
+    dccthread_yield();
+    print(shm);
+
+    flag = 1;
+    dccthread_unpark(&flag, 1);
+    dccthread_t* t = dccthread_create("spin", spin, 0);
+    dccthread_wait(t);
+    struct timespec ts = {0, 300000000};
+    dccthread_sleep(ts);
+    print(shm);
+
+    struct dccthread_shm_stats s;
+    dccthread_stats_read(shm, &s);
+    printf("switches %d preemptions %d idle %d\n",
+           s.switches > 10,
+           s.preemptions > 0,
+           s.idle_ns > 100000000);
+    shm_unlink(name);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
@@ -0,0 +1,37 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "dccthread.h"
+
+dccthread_t* main_thread;
+
+void* helper(void* arg) {
+    usleep(500000);
+    dccthread_wake_remote(main_thread);
+    return NULL;
+}
+
+// Função de teste para o tempo virtual sem ninguém dormindo: enquanto a única
+// thread espera ser acordada por outra thread do SO, o escalonador dorme em
+// vez de girar
+void test(int dummy) {
+    pthread_t pthread;
+    main_thread = dccthread_self();
+    pthread_create(&pthread, NULL, helper, NULL);
+    dccthread_park();
+    pthread_join(pthread, NULL);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+                 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    printf("Thread %s acordada\n", dccthread_name(dccthread_self()));
+    printf("scheduler idle while blocked: %d\n", cpu < 0.25);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) {
+    dccthread_init_flags(test, 0, DCCTHREAD_VIRTUAL_TIME);
+}
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+#define NUM_THREADS 2
+
+volatile int stop = 0;
+// Um contador por thread: um contador compartilhado perderia incrementos com
+// a preempção
+volatile unsigned long counters[2][NUM_THREADS];
+
+void spin(int id) {
+    while(!stop) counters[id / NUM_THREADS][id % NUM_THREADS]++;
+    dccthread_exit();
+}
+
+// Função de teste para os grupos com peso: o grupo de peso 3072 recebe três
+// vezes o tempo de CPU do grupo de peso 1024
+void test(int dummy) {
+    dccthread_group_t* groups[2] = {dccthread_sched_group_create(1024),
+                                    dccthread_sched_group_create(3072)};
+    dccthread_t* threads[2 * NUM_THREADS];
+    for(int i = 0; i < 2 * NUM_THREADS; i++)
+        threads[i] = dccthread_create_in_group(
+            groups[i / NUM_THREADS], "spin", spin, i);
+
+    struct timespec ts = {0, 800000000};
+    dccthread_sleep(ts);
+    stop = 1;
+    for(int i = 0; i < 2 * NUM_THREADS; i++) dccthread_wait(threads[i]);
+
+    double totals[2] = {0, 0};
+    for(int g = 0; g < 2; g++)
+        for(int i = 0; i < NUM_THREADS; i++) totals[g] += counters[g][i];
+    double share = totals[0] / (totals[0] + totals[1]);
+    printf("weight 1024 share within 25%% +- 4%%: %d\n",
+           share > 0.21 && share < 0.29);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
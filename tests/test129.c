@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dccthread.h"
+
+void sleeper(int ms) {
+    struct timespec ts = {0, ms * 1000000};
+    dccthread_sleep(ts);
+    printf("Thread %s terminando\n", dccthread_name(dccthread_self()));
+    dccthread_exit();
+}
+
+void worker(int id) {
+    printf("Thread %s terminando\n", dccthread_name(dccthread_self()));
+    dccthread_exit();
+}
+
+// Função de teste para dccthread_create_in_group_timeout
+void test(int dummy) {
+    dccthread_group_t* group = dccthread_sched_group_create(1024);
+    struct timespec short_wait = {0, 50000000};
+    struct timespec long_wait = {2, 0};
+
+    dccthread_set_limits(0, 2, DCCTHREAD_LIMIT_BLOCK);
+    dccthread_t* s = dccthread_create_in_group(group, "s", sleeper, 300);
+    // A thread s so termina depois do prazo
+    if(!dccthread_create_in_group_timeout(group, "w1", worker, 1, short_wait))
+        printf("w1 nao foi criada\n");
+    dccthread_t* w2 =
+        dccthread_create_in_group_timeout(group, "w2", worker, 2, long_wait);
+    if(w2) printf("w2 criada\n");
+    dccthread_wait(s);
+    dccthread_wait(w2);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dccthread.h"
+
+#define NUM_SLEEPS 100
+
+volatile int stop = 0;
+
+void spin(int dummy) {
+    while(!stop) {
+    }
+    dccthread_exit();
+}
+
+int cmp(const void* a, const void* b) {
+    long x = *(const long*)a, y = *(const long*)b;
+    return (x > y) - (x < y);
+}
+
+// Função de teste para a precisão de dccthread_sleep_precise com threads
+// ocupando a CPU: a thread acordada passa na frente delas
+void test(int dummy) {
+    dccthread_t* spinners[2];
+    for(int i = 0; i < 2; i++) spinners[i] = dccthread_create("spin", spin, i);
+
+    long late[NUM_SLEEPS];
+    struct timespec ts = {0, 2000000};
+    for(int i = 0; i < NUM_SLEEPS; i++) {
+        struct timespec before, after;
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        dccthread_sleep_precise(ts);
+        clock_gettime(CLOCK_MONOTONIC, &after);
+        late[i] = (after.tv_sec - before.tv_sec) * 1000000000L
+                  + (after.tv_nsec - before.tv_nsec) - ts.tv_nsec;
+    }
+    stop = 1;
+    for(int i = 0; i < 2; i++) dccthread_wait(spinners[i]);
+
+    qsort(late, NUM_SLEEPS, sizeof(long), cmp);
+    printf("never early: %d\n", late[0] >= 0);
+    // Bem abaixo de uma fatia de tempo (10ms)
+    printf("p90 lateness under 2ms: %d\n", late[NUM_SLEEPS * 9 / 10] < 2000000);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
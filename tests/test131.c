@@ -0,0 +1,56 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dccthread.h"
+
+volatile int holder_created = 0;
+
+void holder(int ms) {
+    struct timespec ts = {0, ms * 1000000};
+    dccthread_sleep(ts);
+    dccthread_exit();
+}
+
+void* other_scheduler(void* arg) {
+    if(dccthread_sched_create(0) == -1) return NULL;
+    dccthread_create("holder", holder, 300);
+    holder_created = 1;
+    dccthread_sched_run();
+    return NULL;
+}
+
+void idle(int dummy) {
+    struct timespec ts = {2, 0};
+    dccthread_sleep(ts);
+    dccthread_exit();
+}
+
+void worker(int dummy) { dccthread_exit(); }
+
+// Função de teste para os limites entre escalonadores: uma thread que termina
+// no escalonador de outra thread do SO libera a criação bloqueada neste
+void test(int dummy) {
+    dccthread_set_limits(0, 3, DCCTHREAD_LIMIT_BLOCK);
+    dccthread_t* idle_thread = dccthread_create("idle", idle, 0);
+    pthread_t pthread;
+    pthread_create(&pthread, NULL, other_scheduler, NULL);
+    struct timespec step = {0, 1000000};
+    while(!holder_created) dccthread_sleep(step);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    dccthread_t* w = dccthread_create("worker", worker, 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("worker criada: %d\n", w != NULL);
+    // Sem o aviso do outro escalonador, só quando a thread idle terminasse
+    printf("antes da thread idle terminar: %d\n", secs < 1);
+    dccthread_wait(w);
+    dccthread_wait(idle_thread);
+    pthread_join(pthread, NULL);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
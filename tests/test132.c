@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dccthread.h"
+
+#define NUM_SLEEPS 100
+
+volatile int stop = 0;
+
+void spin(int dummy) {
+    while(!stop) {
+    }
+    dccthread_exit();
+}
+
+int cmp(const void* a, const void* b) {
+    long x = *(const long*)a, y = *(const long*)b;
+    return (x > y) - (x < y);
+}
+
+// Mede o atraso de cada dccthread_sleep_precise, dividindo a CPU do seu
+// grupo com uma thread ocupada
+void sleeper(int dummy) {
+    long late[NUM_SLEEPS];
+    struct timespec ts = {0, 2000000};
+    for(int i = 0; i < NUM_SLEEPS; i++) {
+        struct timespec before, after;
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        dccthread_sleep_precise(ts);
+        clock_gettime(CLOCK_MONOTONIC, &after);
+        late[i] = (after.tv_sec - before.tv_sec) * 1000000000L
+                  + (after.tv_nsec - before.tv_nsec) - ts.tv_nsec;
+    }
+    stop = 1;
+
+    qsort(late, NUM_SLEEPS, sizeof(long), cmp);
+    printf("never early: %d\n", late[0] >= 0);
+    // Bem abaixo de uma fatia de tempo (10ms)
+    printf("p90 lateness under 2ms: %d\n", late[NUM_SLEEPS * 9 / 10] < 2000000);
+    dccthread_exit();
+}
+
+// Função de teste para a precisão de dccthread_sleep_precise com grupos: a
+// thread acordada passa na frente mesmo quando o seu grupo usou mais CPU
+void test(int dummy) {
+    dccthread_group_t* groups[2];
+    dccthread_t* spinners[2];
+    for(int i = 0; i < 2; i++) {
+        groups[i] = dccthread_sched_group_create(DCCTHREAD_DEFAULT_WEIGHT);
+        spinners[i] = dccthread_create_in_group(groups[i], "spin", spin, i);
+    }
+    dccthread_t* t =
+        dccthread_create_in_group(groups[0], "sleeper", sleeper, 0);
+
+    dccthread_wait(t);
+    for(int i = 0; i < 2; i++) dccthread_wait(spinners[i]);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
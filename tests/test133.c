@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dccthread.h"
+
+void busy_gen(void* param) {
+    for(int i = 0; i < 4; i++) {
+        volatile unsigned long sum = 0;
+        for(unsigned long j = 0; j < 25000000; j++) {
+            sum += j;
+        }
+        dccthread_yield_value(param);
+    }
+}
+
+void consumer(int dummy) {
+    dccthread_gen_t* gen = dccthread_gen_create(busy_gen, NULL);
+    while(!dccthread_gen_done(gen)) dccthread_gen_next(gen);
+    dccthread_gen_destroy(gen);
+    dccthread_exit();
+}
+
+// Função de teste para o profiler com geradores: o tempo gasto na pilha do
+// gerador conta para a thread que o consome, e não para o escalonador
+void test(int dummy) {
+    FILE* out = tmpfile();
+    dccthread_profile_start(1000);
+    dccthread_t* t = dccthread_create("consumer", consumer, 0);
+    dccthread_wait(t);
+    int n = dccthread_profile_stop(out);
+    printf("profiler stopped %s\n", n > 0 ? "with samples" : "empty");
+
+    int on_consumer = 0, on_scheduler = 0;
+    char line[4096];
+    rewind(out);
+    while(fgets(line, sizeof(line), out)) {
+        int count;
+        char* last = strrchr(line, ' ');
+        if(!last || sscanf(last, "%d", &count) != 1) continue;
+        if(!strncmp(line, "consumer;", 9)) on_consumer += count;
+        if(!strncmp(line, "[scheduler]", 11)) on_scheduler += count;
+    }
+    printf("consumer %s\n", on_consumer > 0 ? "sampled" : "not sampled");
+    printf("most samples on consumer: %d\n", on_consumer > on_scheduler);
+    fclose(out);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
@@ -0,0 +1,75 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dccthread.h"
+
+// Cabem 64 threads no heap de timers antes dele crescer
+#define NUM_SLEEPERS 64
+
+extern void* __libc_realloc(void* ptr, size_t size);
+
+int fail_realloc = 0;
+
+// Simula a falta de memória quando o heap de timers precisa crescer
+void* realloc(void* ptr, size_t size) {
+    return fail_realloc ? NULL : __libc_realloc(ptr, size);
+}
+
+void sleeper(int dummy) {
+    struct timespec ts = {0, 300000000};
+    dccthread_sleep(ts);
+    dccthread_exit();
+}
+
+void worker(int dummy) { dccthread_exit(); }
+
+// Função de teste para as chamadas com prazo quando o timer não pode ser
+// criado: elas retornam com ENOMEM sem bloquear
+void test(int dummy) {
+    dccthread_t* sleepers[NUM_SLEEPERS];
+    for(int i = 0; i < NUM_SLEEPERS; i++)
+        sleepers[i] = dccthread_create("sleeper", sleeper, 0);
+    dccthread_group_t* group = dccthread_sched_group_create(1024);
+    dccthread_yield();
+
+    struct timespec timeout = {1, 0};
+    volatile int addr = 0;
+    int errs[6];
+    fail_realloc = 1;
+    errno = 0;
+    errs[0] = dccthread_wait_timeout(sleepers[0], timeout) == -1
+              && errno == ENOMEM;
+    errno = 0;
+    errs[1] = dccthread_park_timeout(timeout) == -1 && errno == ENOMEM;
+    errno = 0;
+    errs[2] =
+        dccthread_park_on_timeout(&addr, 0, timeout) == -1 && errno == ENOMEM;
+    errno = 0;
+    errs[3] = dccthread_sleep(timeout) == -1 && errno == ENOMEM;
+    errno = 0;
+    errs[4] = dccthread_sleep_precise(timeout) == -1 && errno == ENOMEM;
+    // Sem espaço para mais threads, a criação teria que esperar
+    dccthread_set_limits(0, NUM_SLEEPERS + 1, DCCTHREAD_LIMIT_BLOCK);
+    errno = 0;
+    errs[5] = !dccthread_create_in_group_timeout(
+                  group, "worker", worker, 0, timeout)
+              && errno == ENOMEM;
+    fail_realloc = 0;
+    dccthread_set_limits(0, 0, DCCTHREAD_LIMIT_FAIL);
+
+    const char* names[6] = {"wait_timeout",
+                            "park_timeout",
+                            "park_on_timeout",
+                            "sleep",
+                            "sleep_precise",
+                            "create_in_group_timeout"};
+    for(int i = 0; i < 6; i++) printf("%s ENOMEM: %d\n", names[i], errs[i]);
+
+    // Nada ficou pela metade: as threads ainda podem ser esperadas
+    for(int i = 0; i < NUM_SLEEPERS; i++) dccthread_wait(sleepers[i]);
+    printf("sleepers done\n");
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
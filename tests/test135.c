@@ -0,0 +1,59 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dccthread.h"
+
+volatile int remote_created = 0;
+
+void remote(int dummy) {
+    struct timespec ts = {0, 300000000};
+    dccthread_sleep(ts);
+    dccthread_exit();
+}
+
+void* other_scheduler(void* arg) {
+    if(dccthread_sched_create(0) == -1) return NULL;
+    dccthread_create("remote", remote, 0);
+    remote_created = 1;
+    dccthread_sched_run();
+    return NULL;
+}
+
+int count(const char* text, const char* pattern) {
+    int n = 0;
+    for(const char* p = strstr(text, pattern); p; p = strstr(p + 1, pattern))
+        n++;
+    return n;
+}
+
+// Função de teste para o dump por sinal com dois escalonadores: o sinal
+// entregue à thread do SO do outro escalonador gera o dump dos dois
+void test(int dummy) {
+    char* text;
+    size_t size;
+    FILE* out = open_memstream(&text, &size);
+    dccthread_dump_on_signal(SIGQUIT, out);
+
+    pthread_t pthread;
+    pthread_create(&pthread, NULL, other_scheduler, NULL);
+    struct timespec step = {0, 1000000};
+    while(!remote_created) dccthread_sleep(step);
+
+    pthread_kill(pthread, SIGQUIT);
+    struct timespec wait = {0, 100000000};
+    dccthread_sleep(wait);
+    pthread_join(pthread, NULL);
+
+    fflush(out);
+    printf("dumps: %d\n", count(text, "dccthread dump: "));
+    printf("main dumped: %d\n", count(text, "thread \"main\" "));
+    printf("remote dumped: %d\n", count(text, "thread \"remote\" "));
+    fclose(out);
+    free(text);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dccthread.h"
+
+volatile int release_last = 0;
+
+void worker(int param) {
+    // A última thread do lote só termina quando o teste deixar
+    while(param == 3 && !release_last) dccthread_yield();
+    dccthread_exit();
+}
+
+// Função de teste para a contabilidade da criação em lote: a memória do
+// lote continua contada até o bloco ser liberado, com a saída da última
+// thread
+void test(int dummy) {
+    struct dccthread_mem_stats before, created, partial, after;
+    dccthread_t* threads[4];
+    dccthread_mem_stats(&before);
+    dccthread_create_many(4, worker, NULL, NULL, threads);
+    dccthread_mem_stats(&created);
+    for(int i = 0; i < 3; i++) dccthread_wait(threads[i]);
+    dccthread_mem_stats(&partial);
+    release_last = 1;
+    dccthread_wait(threads[3]);
+    dccthread_mem_stats(&after);
+
+    printf("batch counted: %d\n", created.bytes > before.bytes);
+    printf("counted until the last exit: %d\n", partial.bytes == created.bytes);
+    printf("threads released on exit: %d\n",
+           partial.threads == created.threads - 3);
+    printf("all released at the end: %d\n",
+           after.bytes == before.bytes && after.threads == before.threads);
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
@@ -0,0 +1,33 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "dccthread.h"
+
+#define NUM_RESETS 50
+#define LARGE_SIZE (4 << 20)
+
+void worker(int dummy) {
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    // Só alocações grandes: a thread nunca pega um bloco pequeno da região
+    for(int i = 0; i < NUM_RESETS; i++) {
+        char* large = dccthread_alloc(LARGE_SIZE);
+        memset(large, 1, LARGE_SIZE);
+        dccthread_arena_reset();
+    }
+    getrusage(RUSAGE_SELF, &after);
+    // Sem liberar, cresceria NUM_RESETS * 4MiB = 200MiB
+    printf("large allocations freed on reset: %d\n",
+           after.ru_maxrss - before.ru_maxrss < 32 * 1024);
+    dccthread_exit();
+}
+
+// Função de teste para dccthread_arena_reset numa thread que só fez
+// alocações grandes
+void test(int dummy) {
+    dccthread_wait(dccthread_create("worker", worker, 0));
+    dccthread_exit();
+}
+
+int main(int argc, char** argv) { dccthread_init(test, 0); }
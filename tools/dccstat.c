@@ -0,0 +1,119 @@
+/**
+ * @file dccstat.c
+ * @brief Prints the scheduler counters a process publishes with
+ * `dccthread_stats_export`, without stopping or slowing it down.
+ *
+ * Usage: ./tools/dccstat <segment> [interval ms]
+ *
+ * Without an interval a single snapshot is printed. With one, a line is
+ * printed every interval with the thread counts and the switches, pre-emptions
+ * and idle time over it, until the publisher is gone or the reader is killed.
+ *
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "dccthread.h"
+
+void print_header(void) {
+    printf("%8s %8s %8s %8s %8s %8s %8s %8s %10s %8s %6s\n",
+           "live",
+           "running",
+           "runnable",
+           "waiting",
+           "sleeping",
+           "parked",
+           "offload",
+           "throttle",
+           "switches",
+           "preempt",
+           "idle%");
+}
+
+void print_line(const struct dccthread_shm_stats* s,
+                const struct dccthread_shm_stats* prev,
+                double secs) {
+    u_int64_t switches = s->switches - (prev ? prev->switches : 0);
+    u_int64_t preemptions = s->preemptions - (prev ? prev->preemptions : 0);
+    double idle = prev && secs > 0
+                      ? (s->idle_ns - prev->idle_ns) / (secs * 1e7)
+                      : 0;
+    printf("%8lu %8lu %8lu %8lu %8lu %8lu %8lu %8lu %10lu %8lu %6.1f\n",
+           (unsigned long)s->live,
+           (unsigned long)s->running,
+           (unsigned long)s->runnable,
+           (unsigned long)s->waiting,
+           (unsigned long)s->sleeping,
+           (unsigned long)s->parked,
+           (unsigned long)s->offloaded,
+           (unsigned long)s->throttled,
+           (unsigned long)switches,
+           (unsigned long)preemptions,
+           idle);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s <segment> [interval ms]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    long interval = argc > 2 ? atol(argv[2]) : 0;
+
+    int fd = shm_open(argv[1], O_RDONLY, 0);
+    if(fd == -1) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    const struct dccthread_shm_stats* shm =
+        mmap(NULL, sizeof(*shm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(shm == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    if(shm->magic != DCCTHREAD_STATS_MAGIC
+       || shm->version != DCCTHREAD_STATS_VERSION) {
+        fprintf(stderr, "%s: not a version %d segment\n",
+                argv[1],
+                DCCTHREAD_STATS_VERSION);
+        return EXIT_FAILURE;
+    }
+
+    struct dccthread_shm_stats prev, cur;
+    if(dccthread_stats_read(shm, &cur) == -1) {
+        fprintf(stderr, "%s: no consistent snapshot\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    printf("pid %lu, scheduler thread %lu, %lu exited without wait\n",
+           (unsigned long)cur.pid,
+           (unsigned long)cur.os_tid,
+           (unsigned long)cur.exited);
+    print_header();
+    if(!interval) {
+        // Totals since the scheduler started
+        print_line(&cur, NULL, 0);
+        return EXIT_SUCCESS;
+    }
+
+    struct timespec ts = {interval / 1000, (interval % 1000) * 1000000};
+    struct timespec last, now;
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    // Stops once the publisher is gone
+    while(kill(cur.pid, 0) == 0) {
+        nanosleep(&ts, NULL);
+        prev = cur;
+        if(dccthread_stats_read(shm, &cur) == -1) continue;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double secs =
+            (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1e9;
+        last = now;
+        print_line(&cur, &prev, secs);
+    }
+    return EXIT_SUCCESS;
+}